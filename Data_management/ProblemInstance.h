@@ -0,0 +1,1874 @@
+/**
+ * @file ProblemInstance.h
+ * @brief Data layer shared by the solver and by the instance tools.
+ *
+ * It contains the readers/writers of the clean CSV data (distance matrix, time matrix,
+ * nodes matrix and edges matrix), the binary instance format and the ProblemInstance class.
+ *
+ * The binary instance format is a single versioned file produced by compileInstance.
+ * The distance and time matrices are stored in it exactly as they are kept in memory,
+ * so a ProblemInstance loaded from it maps the file and uses the matrices in place
+ * (no parsing, startup does not depend on the size of the matrices).
+ */
+#ifndef PROBLEMINSTANCE_H
+#define PROBLEMINSTANCE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cmath> // For std::isnan
+#include <algorithm> // For std::next_permutation
+#include <random> // For std::mt19937
+#include <ctime> // For std::time
+#include <iomanip>   // For std::fixed, std::setprecision
+#include <numeric> // for std::accumulate
+#include <unordered_set> // For std::unordered_set
+#include <cstdint> // For fixed width integers of the binary format
+#include <cstring> // For std::memcpy, std::strncpy
+#include <memory> // For std::shared_ptr
+#include <array> // For the fixed width loads of a route
+#include <stdexcept> // For std::runtime_error
+#include <string_view> // For std::string_view
+#include <charconv> // For std::from_chars
+#include <cassert> // For assert
+#include <new> // For std::align_val_t
+#include <queue> // For std::priority_queue
+#include <thread> // For std::thread
+#include <atomic> // For std::atomic
+#include <mutex> // For std::mutex
+#include <cstdio> // For std::snprintf
+#include <limits> // For std::numeric_limits
+#include <filesystem> // For std::filesystem::directory_iterator
+#include <fcntl.h> // For open
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <unistd.h> // For close
+#ifdef __AVX2__
+#include <immintrin.h> // For the AVX2 gathers of DistanceMatrix::gatherArcs
+#endif
+
+
+// ----------------- For all matrices -----------------
+
+// Reader of a CSV file that returns one line at a time without allocating.
+// The file is read in chunks into one fixed buffer: a line is a view on that buffer,
+// valid until the next call of nextLine. Blank lines are skipped and '\r' is removed.
+class CSVReader {
+public:
+    explicit CSVReader(const std::string& filePath, size_t chunkSize = 1 << 20)
+        : file(filePath, std::ios::binary), path(filePath), buffer(chunkSize), begin(0), end(0), lineNumber(0) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Error opening file " + filePath);
+        }
+    }
+
+    // Get the next non blank line, false at the end of the file
+    bool nextLine(std::string_view& line) {
+        while (true) {
+            const char* start = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+
+            if (newline == nullptr && !refill()) {
+                // Last line of the file without the final newline
+                if (begin == end) {
+                    return false;
+                }
+                line = std::string_view(buffer.data() + begin, end - begin);
+                begin = end;
+            } else if (newline == nullptr) {
+                continue; // More data was read, look again for the newline
+            } else {
+                line = std::string_view(start, newline - start);
+                begin += line.size() + 1;
+            }
+
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.find_first_not_of(" \t") != std::string_view::npos) {
+                return true;
+            }
+        }
+    }
+
+    size_t getLineNumber() const { return lineNumber; }
+    const std::string& getPath() const { return path; }
+
+private:
+    // Move the incomplete line to the front of the buffer and read the next chunk after it
+    bool refill() {
+        if (!file) {
+            return false;
+        }
+        size_t pending = end - begin;
+        if (pending == buffer.size()) {
+            buffer.resize(buffer.size() * 2); // A line longer than the buffer
+        }
+        std::memmove(buffer.data(), buffer.data() + begin, pending);
+        begin = 0;
+        end = pending;
+        file.read(buffer.data() + end, buffer.size() - end);
+        end += static_cast<size_t>(file.gcount());
+        return end > pending;
+    }
+
+    std::ifstream file;
+    std::string path;
+    std::vector<char> buffer;
+    size_t begin; // First character not returned yet
+    size_t end; // End of the valid data of the buffer
+    size_t lineNumber;
+};
+
+// Function to cut the next field (up to the delimiter) from the front of a line
+inline bool nextField(std::string_view& line, std::string_view& field, char delimiter = ',') {
+    if (line.data() == nullptr) {
+        return false; // The last field was already returned
+    }
+    size_t position = line.find(delimiter);
+    if (position == std::string_view::npos) {
+        field = line;
+        line = std::string_view();
+    } else {
+        field = line.substr(0, position);
+        line.remove_prefix(position + 1);
+    }
+    // Remove spaces around the field
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+    return true;
+}
+
+// Function to parse a number from a field: the whole field must be the number
+template <typename T>
+T parseField(std::string_view field, const CSVReader& reader) {
+    if (!field.empty() && field.front() == '+') {
+        field.remove_prefix(1); // from_chars does not accept the plus sign
+    }
+    T value{};
+    auto [last, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (error != std::errc() || last != field.data() + field.size()) {
+        throw std::runtime_error("Invalid number '" + std::string(field) + "' at line " +
+                                 std::to_string(reader.getLineNumber()) + " of " + reader.getPath());
+    }
+    return value;
+}
+
+// Function to split a line into at most maxFields fields, it returns the number of fields of the line
+// (it can be larger than maxFields: the extra fields are not stored)
+inline size_t splitFields(std::string_view line, std::string_view* fields, size_t maxFields, char delimiter = ',') {
+    size_t count = 0;
+    std::string_view field;
+    while (nextField(line, field, delimiter)) {
+        if (count < maxFields) {
+            fields[count] = field;
+        }
+        ++count;
+    }
+    return count;
+}
+
+// Function to find the only file of the folder whose name ends with the given suffix (e.g. "_nodes.csv")
+inline std::string findFileWithSuffix(const std::string& folderPath, const std::string& suffix) {
+    std::string found;
+    for (const auto& entry : std::filesystem::directory_iterator(folderPath)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            if (!found.empty()) {
+                throw std::runtime_error("More than one file ending with " + suffix + " in " + folderPath);
+            }
+            found = name;
+        }
+    }
+    if (found.empty()) {
+        throw std::runtime_error("No file ending with " + suffix + " in " + folderPath);
+    }
+    return found;
+}
+
+// Read-only memory mapping of a whole file (unmapped when the last owner goes away)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filePath) : data(nullptr), size(0) {
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Error opening file " + filePath);
+        }
+
+        struct stat fileStat;
+        if (::fstat(fd, &fileStat) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Error reading the size of " + filePath);
+        }
+        size = static_cast<size_t>(fileStat.st_size);
+
+        if (size > 0) {
+            void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Error mapping " + filePath);
+            }
+            data = static_cast<const char*>(address);
+        }
+        ::close(fd); // The mapping stays valid after closing the descriptor
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data;
+    size_t size;
+};
+
+
+// ----------------- Distance and Time matrices -----------------
+
+// Allocator that aligns the matrix buffers to a cache line (and to the AVX registers)
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Storage of the values of a DistanceMatrix, chosen at load time.
+// Double keeps the values of the CSV, Float halves the memory, FixedPoint stores
+// round(value * scale) as uint32 (e.g. decimetres for the distances, seconds for the times).
+// The values are always returned as double, so the fitness is accumulated in double.
+enum class MatrixPrecision { Double, Float, FixedPoint };
+
+// Scales of the fixed point storage
+const double DISTANCE_FIXED_POINT_SCALE = 10.0; // Metres -> decimetres
+const double TIME_FIXED_POINT_SCALE = 1.0; // Seconds
+
+// Function to get the name of a precision (for the prints)
+inline const char* matrixPrecisionName(MatrixPrecision precision) {
+    switch (precision) {
+        case MatrixPrecision::Double: return "double";
+        case MatrixPrecision::Float: return "float32";
+        case MatrixPrecision::FixedPoint: return "uint32 fixed point";
+    }
+    return "unknown";
+}
+
+// Distance (or time) matrix between the nodes, stored as one contiguous row-major aligned buffer.
+// The header row and column of the CSV are removed at load time, so at(i, j) is the distance
+// from node i to node j (no +1 offset).
+// The buffer is either owned or a view on a mapped instance file (kept alive by the matrix).
+class DistanceMatrix {
+public:
+    using Buffer = std::vector<double, AlignedAllocator<double>>;
+    using FloatBuffer = std::vector<float, AlignedAllocator<float>>;
+    using FixedPointBuffer = std::vector<uint32_t, AlignedAllocator<uint32_t>>;
+
+    DistanceMatrix() : n(0), precision(MatrixPrecision::Double), inverseScale(1.0), data(nullptr), doubleValues(nullptr) {}
+
+    // Owned matrix built from a row-major buffer of numNodes x numNodes values
+    DistanceMatrix(size_t numNodes, Buffer values)
+        : n(numNodes), precision(MatrixPrecision::Double), inverseScale(1.0), storage(std::move(values)) {
+        checkSize(storage.size());
+        setData(storage.data());
+    }
+
+    DistanceMatrix(size_t numNodes, FloatBuffer values)
+        : n(numNodes), precision(MatrixPrecision::Float), inverseScale(1.0), floatStorage(std::move(values)) {
+        checkSize(floatStorage.size());
+        setData(floatStorage.data());
+    }
+
+    DistanceMatrix(size_t numNodes, FixedPointBuffer values, double scale)
+        : n(numNodes), precision(MatrixPrecision::FixedPoint), inverseScale(1.0 / scale), fixedPointStorage(std::move(values)) {
+        checkSize(fixedPointStorage.size());
+        setData(fixedPointStorage.data());
+    }
+
+    // View on a buffer of doubles owned by a mapped file
+    DistanceMatrix(size_t numNodes, const double* values, std::shared_ptr<const MappedFile> file)
+        : n(numNodes), precision(MatrixPrecision::Double), inverseScale(1.0), data(values), doubleValues(values), mapping(std::move(file)) {}
+
+    DistanceMatrix(const DistanceMatrix& other)
+        : n(other.n), precision(other.precision), inverseScale(other.inverseScale), storage(other.storage),
+          floatStorage(other.floatStorage), fixedPointStorage(other.fixedPointStorage), mapping(other.mapping) {
+        setData(other.isMapped() ? other.data : ownedData());
+    }
+
+    DistanceMatrix& operator=(const DistanceMatrix& other) {
+        if (this != &other) {
+            n = other.n;
+            precision = other.precision;
+            inverseScale = other.inverseScale;
+            storage = other.storage;
+            floatStorage = other.floatStorage;
+            fixedPointStorage = other.fixedPointStorage;
+            mapping = other.mapping;
+            setData(other.isMapped() ? other.data : ownedData());
+        }
+        return *this;
+    }
+
+    // Moving a std::vector keeps its buffer, so data stays valid
+    DistanceMatrix(DistanceMatrix&& other) = default;
+    DistanceMatrix& operator=(DistanceMatrix&& other) = default;
+
+    // Distance from node i to node j
+    inline double at(size_t i, size_t j) const {
+        assert(i < n && j < n);
+        size_t k = i * n + j;
+        // The double buffer is fixed at load time, so the double path is one load
+        if (doubleValues != nullptr) return doubleValues[k];
+        return reducedAt(k);
+    }
+
+    // Method to read the cost of count arcs at once: costs[k] = at(from[k], to[k]).
+    // With AVX2 (compile with -mavx2) the values are loaded with gathers, 4 or 8 arcs per instruction,
+    // otherwise with the scalar loop. Both give the same values of at(), for every precision.
+    void gatherArcs(const int32_t* from, const int32_t* to, size_t count, double* costs) const {
+        if (n * n > static_cast<size_t>(INT32_MAX)) {
+            throw std::runtime_error("Matrix too large for 32 bit gather indices");
+        }
+        size_t k = 0;
+#ifdef __AVX2__
+        // The masked gathers with a zero source avoid reading an uninitialized register
+        const __m256i rowSize = _mm256_set1_epi32(static_cast<int>(n));
+        const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+        switch (precision) {
+            case MatrixPrecision::Double: {
+                const double* values = static_cast<const double*>(data);
+                for (; k + 8 <= count; k += 8) {
+                    __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + k)), rowSize),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + k)));
+                    _mm256_storeu_pd(costs + k, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), values, _mm256_castsi256_si128(index), allLanes, 8));
+                    _mm256_storeu_pd(costs + k + 4, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), values, _mm256_extracti128_si256(index, 1), allLanes, 8));
+                }
+                break;
+            }
+            case MatrixPrecision::Float: {
+                const float* values = static_cast<const float*>(data);
+                for (; k + 8 <= count; k += 8) {
+                    __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + k)), rowSize),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + k)));
+                    __m256 gathered = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), values, index, _mm256_castpd_ps(allLanes), 4);
+                    _mm256_storeu_pd(costs + k, _mm256_cvtps_pd(_mm256_castps256_ps128(gathered)));
+                    _mm256_storeu_pd(costs + k + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(gathered, 1)));
+                }
+                break;
+            }
+            case MatrixPrecision::FixedPoint: {
+                // uint32 to double: flip the sign bit, convert as signed and add 2^31 back
+                const int* values = static_cast<const int*>(data);
+                const __m256i signBit = _mm256_set1_epi32(INT32_MIN);
+                const __m256d bias = _mm256_set1_pd(2147483648.0);
+                const __m256d scale = _mm256_set1_pd(inverseScale);
+                for (; k + 8 <= count; k += 8) {
+                    __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + k)), rowSize),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + k)));
+                    __m256i gathered = _mm256_xor_si256(_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), values, index, _mm256_castpd_si256(allLanes), 4), signBit);
+                    __m256d low = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(gathered)), bias);
+                    __m256d high = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(gathered, 1)), bias);
+                    _mm256_storeu_pd(costs + k, _mm256_mul_pd(low, scale));
+                    _mm256_storeu_pd(costs + k + 4, _mm256_mul_pd(high, scale));
+                }
+                break;
+            }
+        }
+#endif
+        // Remaining arcs (all of them without AVX2), with the precision chosen once for the whole loop
+        switch (precision) {
+            case MatrixPrecision::Double:
+                gatherArcsScalar(static_cast<const double*>(data), 1.0, from, to, k, count, costs);
+                break;
+            case MatrixPrecision::Float:
+                gatherArcsScalar(static_cast<const float*>(data), 1.0, from, to, k, count, costs);
+                break;
+            case MatrixPrecision::FixedPoint:
+                gatherArcsScalar(static_cast<const uint32_t*>(data), inverseScale, from, to, k, count, costs);
+                break;
+        }
+    }
+
+    // Name of the kernel used by gatherArcs
+    static const char* gatherKernelName() {
+#ifdef __AVX2__
+        return "AVX2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Copy of the matrix stored with another precision (scale is used only by FixedPoint)
+    DistanceMatrix withPrecision(MatrixPrecision newPrecision, double scale) const {
+        size_t count = n * n;
+        switch (newPrecision) {
+            case MatrixPrecision::Double: {
+                Buffer values(count);
+                for (size_t k = 0; k < count; ++k) values[k] = at(k / n, k % n);
+                return DistanceMatrix(n, std::move(values));
+            }
+            case MatrixPrecision::Float: {
+                FloatBuffer values(count);
+                for (size_t k = 0; k < count; ++k) values[k] = static_cast<float>(at(k / n, k % n));
+                return DistanceMatrix(n, std::move(values));
+            }
+            case MatrixPrecision::FixedPoint: {
+                FixedPointBuffer values(count);
+                for (size_t k = 0; k < count; ++k) values[k] = toFixedPoint(at(k / n, k % n), scale);
+                return DistanceMatrix(n, std::move(values), scale);
+            }
+        }
+        return *this;
+    }
+
+    // Function to convert one value to the fixed point storage
+    static uint32_t toFixedPoint(double value, double scale) {
+        double scaled = std::round(value * scale);
+        if (!(scaled >= 0.0 && scaled <= static_cast<double>(UINT32_MAX))) {
+            throw std::runtime_error("Value " + std::to_string(value) + " cannot be stored as uint32 fixed point");
+        }
+        return static_cast<uint32_t>(scaled);
+    }
+
+    size_t size() const { return n; }
+    MatrixPrecision getPrecision() const { return precision; }
+    size_t bytes() const {
+        switch (precision) {
+            case MatrixPrecision::Double: return n * n * sizeof(double);
+            case MatrixPrecision::Float: return n * n * sizeof(float);
+            case MatrixPrecision::FixedPoint: return n * n * sizeof(uint32_t);
+        }
+        return 0;
+    }
+    // Buffer of doubles (only for the Double precision)
+    const double* values() const {
+        if (doubleValues == nullptr) {
+            throw std::runtime_error("The matrix is not stored as double");
+        }
+        return doubleValues;
+    }
+    bool isMapped() const { return mapping != nullptr; }
+
+private:
+    template <typename T>
+    void gatherArcsScalar(const T* values, double scale, const int32_t* from, const int32_t* to, size_t k, size_t count, double* costs) const {
+        for (; k < count; ++k) {
+            assert(static_cast<size_t>(from[k]) < n && static_cast<size_t>(to[k]) < n);
+            costs[k] = values[static_cast<size_t>(from[k]) * n + to[k]] * scale;
+        }
+    }
+
+    // Value k of a Float or FixedPoint matrix
+    double reducedAt(size_t k) const {
+        if (precision == MatrixPrecision::Float) return static_cast<const float*>(data)[k];
+        return static_cast<const uint32_t*>(data)[k] * inverseScale;
+    }
+
+    // Function to fix data and doubleValues after the buffer is set
+    void setData(const void* values) {
+        data = values;
+        doubleValues = precision == MatrixPrecision::Double ? static_cast<const double*>(values) : nullptr;
+    }
+
+    void checkSize(size_t count) const {
+        if (count != n * n) {
+            throw std::runtime_error("Matrix buffer does not match its dimensions");
+        }
+    }
+
+    const void* ownedData() const {
+        switch (precision) {
+            case MatrixPrecision::Double: return storage.data();
+            case MatrixPrecision::Float: return floatStorage.data();
+            case MatrixPrecision::FixedPoint: return fixedPointStorage.data();
+        }
+        return nullptr;
+    }
+
+    size_t n;
+    MatrixPrecision precision;
+    double inverseScale; // 1 / scale of the fixed point storage
+    Buffer storage;
+    FloatBuffer floatStorage;
+    FixedPointBuffer fixedPointStorage;
+    const void* data;
+    const double* doubleValues; // data for the Double precision, nullptr otherwise
+    std::shared_ptr<const MappedFile> mapping;
+};
+
+// Function to read a matrix CSV file and return a matrix of doubles.
+// If the first cell is "nan" the first row and the first column are the indices of the nodes:
+// they are checked (0, 1, 2, ... in order) and removed.
+// With a reduced precision the values are converted while parsing (no double copy of the matrix).
+inline DistanceMatrix readSquaredCSV(const std::string& filePath,
+                                     MatrixPrecision precision = MatrixPrecision::Double,
+                                     double scale = 1.0) {
+    CSVReader reader(filePath);
+
+    DistanceMatrix::Buffer values;
+    DistanceMatrix::FloatBuffer floatValues;
+    DistanceMatrix::FixedPointBuffer fixedPointValues;
+    std::string_view line;
+    std::string_view field;
+    bool hasHeader = false;
+    size_t numRows = 0;
+    size_t numCols = 0;
+
+    while (reader.nextLine(line)) {
+        size_t rowCols = 0;
+        while (nextField(line, field)) {
+            double value = parseField<double>(field, reader);
+            if (numRows == 0 && rowCols == 0) {
+                hasHeader = std::isnan(value);
+            }
+
+            if (hasHeader && (numRows == 0 || rowCols == 0)) {
+                // Index of the header row or column
+                size_t expected = (numRows == 0) ? rowCols - 1 : numRows - 1;
+                if ((numRows != 0 || rowCols != 0) && value != static_cast<double>(expected)) {
+                    throw std::runtime_error("Unexpected node index at line " + std::to_string(reader.getLineNumber()) +
+                                             " of " + filePath + " (the indices must be 0, 1, 2, ...)");
+                }
+            } else if (precision == MatrixPrecision::Double) {
+                values.push_back(value);
+            } else if (precision == MatrixPrecision::Float) {
+                floatValues.push_back(static_cast<float>(value));
+            } else {
+                fixedPointValues.push_back(DistanceMatrix::toFixedPoint(value, scale));
+            }
+            ++rowCols;
+        }
+
+        if (numRows == 0) {
+            numCols = rowCols;
+            size_t n = hasHeader ? numCols - 1 : numCols;
+            if (precision == MatrixPrecision::Double) values.reserve(n * n);
+            else if (precision == MatrixPrecision::Float) floatValues.reserve(n * n);
+            else fixedPointValues.reserve(n * n);
+        } else if (rowCols != numCols) {
+            throw std::runtime_error("Rows of different length in " + filePath);
+        }
+        ++numRows;
+    }
+
+    size_t n = hasHeader ? numCols - 1 : numCols;
+    if ((hasHeader ? numRows - 1 : numRows) != n) {
+        throw std::runtime_error("The matrix of " + filePath + " is not squared");
+    }
+    if (precision == MatrixPrecision::Float) {
+        return DistanceMatrix(n, std::move(floatValues));
+    }
+    if (precision == MatrixPrecision::FixedPoint) {
+        return DistanceMatrix(n, std::move(fixedPointValues), scale);
+    }
+    return DistanceMatrix(n, std::move(values));
+}
+
+// Function to compute the largest absolute difference between two matrices of the same size
+inline double maxMatrixDifference(const DistanceMatrix& a, const DistanceMatrix& b) {
+    if (a.size() != b.size()) {
+        throw std::runtime_error("Matrices of different size");
+    }
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; j < a.size(); ++j) {
+            maxDifference = std::max(maxDifference, std::abs(a.at(i, j) - b.at(i, j)));
+        }
+    }
+    return maxDifference;
+}
+
+// Function to print a squared matrix
+inline void printSquaredMatrix(const DistanceMatrix& matrix) {
+    for (size_t i = 0; i < matrix.size(); ++i) {
+        for (size_t j = 0; j < matrix.size(); ++j) {
+            std::cout << matrix.at(i, j) << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// ----------------- School demands -----------------
+
+// Maximum number of schools (clusters) of an instance: the loads of a route are kept in a fixed width array
+const int MAX_SCHOOLS = 32;
+
+// Children carried to each school (position k is school k + 1), the positions after the last school stay 0
+using SchoolLoads = std::array<int, MAX_SCHOOLS>;
+
+// Function to sum the first numSchools loads (a plain loop, vectorized by the compiler)
+inline int sumSchoolLoads(const int* loads, int numSchools) {
+    int total = 0;
+    for (int k = 0; k < numSchools; ++k) {
+        total += loads[k];
+    }
+    return total;
+}
+
+// Same, with the number of schools known at compile time: the loop is fully unrolled
+template <int NumSchools>
+inline int sumSchoolLoads(const int* loads) {
+    int total = 0;
+    for (int k = 0; k < NumSchools; ++k) {
+        total += loads[k];
+    }
+    return total;
+}
+
+// Function to sum the loads, with the unrolled version for the small instances (up to four schools)
+inline int totalSchoolLoad(const int* loads, int numSchools) {
+    switch (numSchools) {
+        case 1: return sumSchoolLoads<1>(loads);
+        case 2: return sumSchoolLoads<2>(loads);
+        case 3: return sumSchoolLoads<3>(loads);
+        case 4: return sumSchoolLoads<4>(loads);
+        default: return sumSchoolLoads(loads, numSchools);
+    }
+}
+
+// Function to add the children of a node to the loads of a route
+inline void addSchoolLoads(int* loads, const int* demands, int numSchools) {
+    for (int k = 0; k < numSchools; ++k) {
+        loads[k] += demands[k];
+    }
+}
+
+// Function to take the children of a node away from the loads of a route
+inline void subtractSchoolLoads(int* loads, const int* demands, int numSchools) {
+    for (int k = 0; k < numSchools; ++k) {
+        loads[k] -= demands[k];
+    }
+}
+
+// Children of each node to each school: one row of numSchools values for each row of the nodes matrix,
+// stored contiguously (the rows of the depot and of the schools are all 0)
+class DemandMatrix {
+public:
+    DemandMatrix() : numRows(0), numSchools(0) {}
+
+    DemandMatrix(size_t rows, int schools)
+        : numRows(rows), numSchools(schools), data(rows * schools, 0) {}
+
+    const int* row(size_t r) const {
+        return data.data() + r * numSchools;
+    }
+
+    int* row(size_t r) {
+        return data.data() + r * numSchools;
+    }
+
+    int at(size_t r, int school) const {
+        return data[r * numSchools + school];
+    }
+
+    size_t rows() const {
+        return numRows;
+    }
+
+    int getNumberOfSchools() const {
+        return numSchools;
+    }
+
+private:
+    size_t numRows;
+    int numSchools;
+    std::vector<int, AlignedAllocator<int>> data;
+};
+
+
+// ----------------- Node matrix -----------------
+
+// Kind of a node (parsed once from the sixth column of the nodes CSV)
+enum class NodeType : int32_t {
+    Depot,   // "deposito"
+    BusStop, // "fermata"
+    Cluster  // "cluster" (school)
+};
+
+// Function to get the kind of a node from its name in the CSV
+inline NodeType parseNodeType(std::string_view name) {
+    if (name == "fermata") return NodeType::BusStop;
+    if (name == "cluster") return NodeType::Cluster;
+    if (name == "deposito") return NodeType::Depot;
+    throw std::runtime_error("Unknown node type '" + std::string(name) + "'");
+}
+
+// Function to get the name of a kind of node, as written in the CSV
+inline const char* nodeTypeName(NodeType type) {
+    switch (type) {
+        case NodeType::Depot: return "deposito";
+        case NodeType::BusStop: return "fermata";
+        case NodeType::Cluster: return "cluster";
+    }
+    return "unknown";
+}
+
+inline std::ostream& operator<<(std::ostream& os, NodeType type) {
+    return os << nodeTypeName(type);
+}
+
+// Define a struct to hold the data for each row
+struct NodeDataRow {
+    int id1;
+    int id2;
+    int id3;
+    double latitude;
+    double longitude;
+    NodeType type;
+    std::vector<int> children_to_cluster; // Number of children to each cluster (position k is cluster k + 1)
+};
+
+// Number of columns of the nodes CSV before the children to each cluster
+const size_t NODE_FIXED_FIELDS = 6;
+
+// Function to read the CSV file and return a vector of DataRow structs
+// After the six fixed columns there is one column for each cluster (school): every row must have the
+// same number of clusters, at most MAX_SCHOOLS. Rows without any cluster column are skipped.
+inline std::vector<NodeDataRow> readNodesCSV(const std::string& filePath) {
+    CSVReader reader(filePath);
+
+    std::vector<NodeDataRow> data;
+    std::string_view line;
+    std::string_view tokens[NODE_FIXED_FIELDS + MAX_SCHOOLS];
+    size_t numFields = 0;
+
+    while (reader.nextLine(line)) {
+        size_t count = splitFields(line, tokens, NODE_FIXED_FIELDS + MAX_SCHOOLS);
+        if (count > NODE_FIXED_FIELDS) {
+            if (data.empty() && tokens[0].find_first_not_of("0123456789+- ") != std::string_view::npos) {
+                continue; // Header row
+            }
+            if (count > NODE_FIXED_FIELDS + MAX_SCHOOLS) {
+                throw std::runtime_error("More than " + std::to_string(MAX_SCHOOLS) + " clusters at line " +
+                                         std::to_string(reader.getLineNumber()) + " of " + filePath);
+            }
+            if (numFields == 0) {
+                numFields = count;
+            } else if (count != numFields) {
+                throw std::runtime_error("Expected " + std::to_string(numFields) + " fields at line " +
+                                         std::to_string(reader.getLineNumber()) + " of " + filePath);
+            }
+            NodeDataRow row;
+            row.id1 = parseField<int>(tokens[0], reader);
+            row.id2 = parseField<int>(tokens[1], reader);
+            row.id3 = parseField<int>(tokens[2], reader);
+            row.latitude = parseField<double>(tokens[3], reader);
+            row.longitude = parseField<double>(tokens[4], reader);
+            try {
+                row.type = parseNodeType(tokens[5]);
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error(std::string(e.what()) + " at line " + std::to_string(reader.getLineNumber()) + " of " + filePath);
+            }
+            row.children_to_cluster.resize(count - NODE_FIXED_FIELDS);
+            for (size_t k = 0; k < row.children_to_cluster.size(); ++k) {
+                row.children_to_cluster[k] = parseField<int>(tokens[NODE_FIXED_FIELDS + k], reader);
+            }
+            data.push_back(std::move(row));
+        }
+    }
+
+    return data;
+}
+
+// Function to get the number of clusters (schools) of the nodes, checking that all the rows have the same
+inline int countNodeClusters(const std::vector<NodeDataRow>& nodesMatrix) {
+    if (nodesMatrix.empty()) {
+        return 0;
+    }
+    size_t numClusters = nodesMatrix.front().children_to_cluster.size();
+    for (const NodeDataRow& row : nodesMatrix) {
+        if (row.children_to_cluster.size() != numClusters) {
+            throw std::runtime_error("Node " + std::to_string(row.id1) + " has " + std::to_string(row.children_to_cluster.size()) +
+                                     " clusters instead of " + std::to_string(numClusters));
+        }
+    }
+    if (numClusters > static_cast<size_t>(MAX_SCHOOLS)) {
+        throw std::runtime_error("More than " + std::to_string(MAX_SCHOOLS) + " clusters");
+    }
+    return static_cast<int>(numClusters);
+}
+
+// Function to print the data matrix
+inline void printNodesMatrix(const std::vector<NodeDataRow>& dataMatrix) {
+    for (const NodeDataRow& row : dataMatrix) {
+        std::cout << row.id1 << " " << row.id2 << " " << row.id3 << " "
+                  << row.latitude << " " << row.longitude << " "
+                  << row.type;
+        for (int children : row.children_to_cluster) {
+            std::cout << " " << children;
+        }
+        std::cout << std::endl;
+    }
+}
+
+// ----------------- Edges matrix -----------------
+
+// Define a struct to hold the data for each row
+struct EdgeDataRow {
+    int source;
+    int target;
+    double weight;
+    double time;
+};
+
+// Function to read the CSV file and return a vector of Edge structs
+inline std::vector<EdgeDataRow> readEdgesCSV(const std::string& filePath) {
+    CSVReader reader(filePath);
+
+    std::vector<EdgeDataRow> data;
+    std::string_view line;
+    std::string_view tokens[4];
+
+    // Skip the header line
+    reader.nextLine(line);
+
+    while (reader.nextLine(line)) {
+        if (splitFields(line, tokens, 4) == 4) {
+            EdgeDataRow edge;
+            edge.source = parseField<int>(tokens[0], reader);
+            edge.target = parseField<int>(tokens[1], reader);
+            edge.weight = parseField<double>(tokens[2], reader);
+            edge.time = parseField<double>(tokens[3], reader);
+            data.push_back(edge);
+        }
+    }
+
+    return data;
+}
+
+
+// Function to print the edge matrix
+inline void printEdgesMatrix(const std::vector<EdgeDataRow>& edgeMatrix) {
+    for (const EdgeDataRow& edge : edgeMatrix) {
+        std::cout << edge.source << " " << edge.target << " "
+                  << edge.weight << " " << edge.time << std::endl;
+    }
+}
+
+// ----------------- Write on csv functions -----------------
+
+// Function to write a number with the shortest text that reads back to the same double
+inline void writeShortestDouble(std::ostream& file, double value) {
+    char text[32];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    file.write(text, result.ptr - text);
+}
+
+// Function to write a matrix to a CSV file (with the header row and column of the indices)
+inline void writeSquaredCSV(const std::string& filePath, const DistanceMatrix& matrix) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    file << "nan";
+    for (size_t j = 0; j < matrix.size(); ++j) {
+        file << "," << static_cast<double>(j);
+    }
+    file << "\n";
+
+    for (size_t i = 0; i < matrix.size(); ++i) {
+        file << static_cast<double>(i);
+        for (size_t j = 0; j < matrix.size(); ++j) {
+            file << ",";
+            writeShortestDouble(file, matrix.at(i, j));
+        }
+        file << "\n";
+    }
+
+    file.close();
+}
+
+// Function to write the NodeDataRow vector to a CSV file
+inline void writeNodesCSV(const std::string& filePath, const std::vector<NodeDataRow>& dataMatrix) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    for (const auto& row : dataMatrix) {
+        file << row.id1 << "," << row.id2 << "," << row.id3 << ","
+             << row.latitude << "," << row.longitude << ","
+             << row.type;
+        for (int children : row.children_to_cluster) {
+            file << "," << children;
+        }
+        file << std::endl;
+    }
+
+    file.close();
+}
+
+// Function to write the EdgeDataRow vector to a CSV file
+inline void writeEdgesCSV(const std::string& filePath, const std::vector<EdgeDataRow>& edgeMatrix) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    file << "source,target,weight,time" << std::endl; // Write header line
+
+    for (const auto& edge : edgeMatrix) {
+        file << edge.source << "," << edge.target << ","
+             << edge.weight << "," << edge.time << std::endl;
+    }
+
+    file.close();
+}
+
+// ----------------- Nearest neighbours -----------------
+
+// Number of nearest neighbours kept for each node
+const size_t NEAREST_NEIGHBORS_COUNT = 16;
+
+// The k nearest nodes of each node of a distance matrix (the node itself excluded), closest first:
+// the neighbours of node i are ids[i * k] ... ids[i * k + k - 1]
+struct NearestNeighbors {
+    size_t numNodes = 0;
+    size_t k = 0;
+    std::vector<int> ids;
+
+    const int* of(int nodeId) const {
+        return ids.data() + static_cast<size_t>(nodeId) * k;
+    }
+};
+
+// Function to compute the nearest neighbours of every node (with the same distance the smaller id comes first)
+inline NearestNeighbors computeNearestNeighbors(const DistanceMatrix& distanceMatrix, size_t k = NEAREST_NEIGHBORS_COUNT) {
+    const size_t n = distanceMatrix.size();
+
+    NearestNeighbors neighbors;
+    neighbors.numNodes = n;
+    neighbors.k = std::min(k, n > 0 ? n - 1 : 0);
+    neighbors.ids.resize(n * neighbors.k);
+
+    std::vector<int> candidates;
+    candidates.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        candidates.clear();
+        for (size_t j = 0; j < n; ++j) {
+            if (j != i) {
+                candidates.push_back(static_cast<int>(j));
+            }
+        }
+        auto closer = [&](int a, int b) {
+            double distanceA = distanceMatrix.at(i, a);
+            double distanceB = distanceMatrix.at(i, b);
+            return distanceA < distanceB || (distanceA == distanceB && a < b);
+        };
+        std::partial_sort(candidates.begin(), candidates.begin() + neighbors.k, candidates.end(), closer);
+        std::copy(candidates.begin(), candidates.begin() + neighbors.k, neighbors.ids.begin() + i * neighbors.k);
+    }
+
+    return neighbors;
+}
+
+
+// ----------------- Binary instance file -----------------
+
+// Layout of the file (all sections start at a multiple of INSTANCE_FILE_ALIGNMENT):
+// InstanceFileHeader | distances (n*n doubles) | times (n*n doubles) | nodes records | demands | edges records | neighbours
+// The matrices are stored without the header row and column of the CSV, the demands are the
+// numNodes x numSchools int32 children of each node to each school (row-major, in the order of the nodes),
+// the neighbours are the n x numNeighbors int32 ids of NearestNeighbors.
+// sourceHash is the hash of the CSV files for the files of the instance cache (0 otherwise).
+// Bump INSTANCE_FILE_VERSION every time the layout changes: old files are then rejected.
+const char INSTANCE_FILE_MAGIC[8] = {'S', 'B', 'R', 'P', 'I', 'N', 'S', 'T'};
+const uint32_t INSTANCE_FILE_VERSION = 5;
+const uint64_t INSTANCE_FILE_ALIGNMENT = 64;
+
+struct InstanceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t matrixSize;
+    uint64_t numNodes;
+    uint64_t numEdges;
+    uint64_t numSchools;
+    uint64_t numNeighbors;
+    uint64_t sourceHash;
+    uint64_t distancesOffset;
+    uint64_t timesOffset;
+    uint64_t nodesOffset;
+    uint64_t demandsOffset;
+    uint64_t edgesOffset;
+    uint64_t neighborsOffset;
+    uint64_t fileSize;
+};
+
+// Fixed size version of NodeDataRow
+struct NodeFileRecord {
+    int32_t id1;
+    int32_t id2;
+    int32_t id3;
+    int32_t type; // NodeType
+    double latitude;
+    double longitude;
+};
+
+struct EdgeFileRecord {
+    int32_t source;
+    int32_t target;
+    double weight;
+    double time;
+};
+
+// Round an offset up to the alignment of the sections
+inline uint64_t alignInstanceOffset(uint64_t offset) {
+    return (offset + INSTANCE_FILE_ALIGNMENT - 1) / INSTANCE_FILE_ALIGNMENT * INSTANCE_FILE_ALIGNMENT;
+}
+
+// Function to write the four matrices to a binary instance file
+inline void writeInstanceFile(const std::string& filePath,
+                              const DistanceMatrix& distancesMatrix,
+                              const DistanceMatrix& timesMatrix,
+                              const std::vector<NodeDataRow>& nodesMatrix,
+                              const std::vector<EdgeDataRow>& edgesMatrix,
+                              const NearestNeighbors& neighbors,
+                              uint64_t sourceHash = 0) {
+    if (distancesMatrix.size() != timesMatrix.size()) {
+        throw std::runtime_error("Distance and time matrices have different dimensions");
+    }
+    if (neighbors.k > 0 && neighbors.numNodes != distancesMatrix.size()) {
+        throw std::runtime_error("The nearest neighbours do not match the distance matrix");
+    }
+    if (distancesMatrix.getPrecision() != MatrixPrecision::Double || timesMatrix.getPrecision() != MatrixPrecision::Double) {
+        throw std::runtime_error("The instance file is written from matrices stored as double");
+    }
+
+    const uint64_t matrixBytes = distancesMatrix.size() * distancesMatrix.size() * sizeof(double);
+    const int numSchools = countNodeClusters(nodesMatrix);
+
+    InstanceFileHeader header = {};
+    std::memcpy(header.magic, INSTANCE_FILE_MAGIC, sizeof(header.magic));
+    header.version = INSTANCE_FILE_VERSION;
+    header.headerSize = sizeof(InstanceFileHeader);
+    header.matrixSize = distancesMatrix.size();
+    header.numNodes = nodesMatrix.size();
+    header.numEdges = edgesMatrix.size();
+    header.numSchools = numSchools;
+    header.numNeighbors = neighbors.k;
+    header.sourceHash = sourceHash;
+    header.distancesOffset = alignInstanceOffset(sizeof(InstanceFileHeader));
+    header.timesOffset = alignInstanceOffset(header.distancesOffset + matrixBytes);
+    header.nodesOffset = alignInstanceOffset(header.timesOffset + matrixBytes);
+    header.demandsOffset = alignInstanceOffset(header.nodesOffset + header.numNodes * sizeof(NodeFileRecord));
+    header.edgesOffset = alignInstanceOffset(header.demandsOffset + header.numNodes * header.numSchools * sizeof(int32_t));
+    header.neighborsOffset = alignInstanceOffset(header.edgesOffset + header.numEdges * sizeof(EdgeFileRecord));
+    header.fileSize = header.neighborsOffset + header.matrixSize * header.numNeighbors * sizeof(int32_t);
+
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    // Write zeros up to the next section
+    auto padTo = [&file](uint64_t offset) {
+        static const char zeros[INSTANCE_FILE_ALIGNMENT] = {};
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(zeros, offset - position);
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    padTo(header.distancesOffset);
+    file.write(reinterpret_cast<const char*>(distancesMatrix.values()), matrixBytes);
+
+    padTo(header.timesOffset);
+    file.write(reinterpret_cast<const char*>(timesMatrix.values()), matrixBytes);
+
+    padTo(header.nodesOffset);
+    for (const auto& node : nodesMatrix) {
+        NodeFileRecord record = {};
+        record.id1 = node.id1;
+        record.id2 = node.id2;
+        record.id3 = node.id3;
+        record.type = static_cast<int32_t>(node.type);
+        record.latitude = node.latitude;
+        record.longitude = node.longitude;
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    padTo(header.demandsOffset);
+    for (const auto& node : nodesMatrix) {
+        for (int children : node.children_to_cluster) {
+            int32_t value = children;
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+    }
+
+    padTo(header.edgesOffset);
+    for (const auto& edge : edgesMatrix) {
+        EdgeFileRecord record = {edge.source, edge.target, edge.weight, edge.time};
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    padTo(header.neighborsOffset);
+    if (header.numNeighbors > 0) {
+        std::vector<int32_t> ids(neighbors.ids.begin(), neighbors.ids.end());
+        file.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(int32_t));
+    }
+
+    if (!file) {
+        throw std::runtime_error("Error writing " + filePath);
+    }
+    file.close();
+}
+
+// Function to check the header of a mapped instance file and return it
+inline const InstanceFileHeader& readInstanceFileHeader(const MappedFile& file) {
+    if (file.size < sizeof(InstanceFileHeader)) {
+        throw std::runtime_error("Instance file too small");
+    }
+
+    const InstanceFileHeader& header = *reinterpret_cast<const InstanceFileHeader*>(file.data);
+    if (std::memcmp(header.magic, INSTANCE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not an instance file (wrong magic)");
+    }
+    if (header.version != INSTANCE_FILE_VERSION || header.headerSize != sizeof(InstanceFileHeader)) {
+        throw std::runtime_error("Unsupported instance file version " + std::to_string(header.version) +
+                                 " (expected " + std::to_string(INSTANCE_FILE_VERSION) + "), recompile it");
+    }
+    if (header.fileSize != file.size) {
+        throw std::runtime_error("Instance file is truncated or corrupted");
+    }
+    return header;
+}
+
+
+// ----------------- Shortest paths -----------------
+
+// Road graph in compressed sparse row form: the arcs leaving node u are
+// targets[offsets[u]] ... targets[offsets[u + 1] - 1] (with their weight and time)
+struct CSRGraph {
+    size_t numNodes;
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<double> weights;
+    std::vector<double> times;
+};
+
+// Function to build the CSR adjacency of the edges matrix
+inline CSRGraph buildCSRGraph(const std::vector<EdgeDataRow>& edgesMatrix, size_t numNodes) {
+    CSRGraph graph;
+    graph.numNodes = numNodes;
+    graph.offsets.assign(numNodes + 1, 0);
+
+    // Count the arcs leaving each node, then turn the counts into offsets
+    for (const auto& edge : edgesMatrix) {
+        if (edge.source < 0 || edge.target < 0 || static_cast<size_t>(edge.source) >= numNodes || static_cast<size_t>(edge.target) >= numNodes) {
+            throw std::runtime_error("Edge " + std::to_string(edge.source) + " -> " + std::to_string(edge.target) + " has an unknown node");
+        }
+        if (edge.weight < 0.0 || edge.time < 0.0) {
+            throw std::runtime_error("Edge " + std::to_string(edge.source) + " -> " + std::to_string(edge.target) + " has a negative weight");
+        }
+        ++graph.offsets[edge.source + 1];
+    }
+    for (size_t u = 0; u < numNodes; ++u) {
+        graph.offsets[u + 1] += graph.offsets[u];
+    }
+
+    graph.targets.resize(edgesMatrix.size());
+    graph.weights.resize(edgesMatrix.size());
+    graph.times.resize(edgesMatrix.size());
+    std::vector<int> next(graph.offsets.begin(), graph.offsets.end() - 1);
+    for (const auto& edge : edgesMatrix) {
+        int position = next[edge.source]++;
+        graph.targets[position] = edge.target;
+        graph.weights[position] = edge.weight;
+        graph.times[position] = edge.time;
+    }
+
+    return graph;
+}
+
+// All pairs shortest paths (by distance) of the road graph.
+// times holds the travel time along the same shortest path.
+// predecessors[s * n + t] is the node before t on the path from s to t (-1 if t is s or it is not reachable).
+struct ShortestPaths {
+    DistanceMatrix distances;
+    DistanceMatrix times;
+    std::vector<int> predecessors;
+
+    // Function to expand the path from node s to node t
+    std::vector<int> path(int s, int t) const;
+};
+
+// Function to expand the path from node s to node t of a predecessors matrix (empty if t is not reachable)
+inline std::vector<int> expandShortestPath(const std::vector<int>& predecessors, size_t n, int s, int t) {
+    std::vector<int> nodes;
+    if (s != t && predecessors[s * n + t] == -1) {
+        return nodes;
+    }
+    for (int v = t; v != s; v = predecessors[s * n + v]) {
+        nodes.push_back(v);
+    }
+    nodes.push_back(s);
+    std::reverse(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+inline std::vector<int> ShortestPaths::path(int s, int t) const {
+    return expandShortestPath(predecessors, distances.size(), s, t);
+}
+
+// Function to run Dijkstra from one source and write the row of the source in the output buffers
+inline void dijkstraFromSource(const CSRGraph& graph, int source, double* distances, double* times, int* predecessors) {
+    using QueueItem = std::pair<double, int>; // (distance, node)
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    std::fill(distances, distances + graph.numNodes, std::numeric_limits<double>::infinity());
+    std::fill(times, times + graph.numNodes, std::numeric_limits<double>::infinity());
+    std::fill(predecessors, predecessors + graph.numNodes, -1);
+
+    distances[source] = 0.0;
+    times[source] = 0.0;
+    queue.push({0.0, source});
+
+    while (!queue.empty()) {
+        auto [distance, u] = queue.top();
+        queue.pop();
+        if (distance > distances[u]) {
+            continue; // Old entry of a node already settled
+        }
+        for (int k = graph.offsets[u]; k < graph.offsets[u + 1]; ++k) {
+            int v = graph.targets[k];
+            double newDistance = distance + graph.weights[k];
+            double newTime = times[u] + graph.times[k];
+            // Between two paths of the same length keep the faster one
+            if (newDistance < distances[v] || (newDistance == distances[v] && newTime < times[v])) {
+                distances[v] = newDistance;
+                times[v] = newTime;
+                predecessors[v] = u;
+                queue.push({newDistance, v});
+            }
+        }
+    }
+}
+
+// Function to compute the distance and time matrices from the edges matrix:
+// Dijkstra from every node, the sources are shared among numThreads threads (0 = all the cores)
+inline ShortestPaths computeAllPairsShortestPaths(const std::vector<EdgeDataRow>& edgesMatrix, size_t numNodes, unsigned numThreads = 0) {
+    CSRGraph graph = buildCSRGraph(edgesMatrix, numNodes);
+
+    DistanceMatrix::Buffer distances(numNodes * numNodes);
+    DistanceMatrix::Buffer times(numNodes * numNodes);
+    std::vector<int> predecessors(numNodes * numNodes);
+
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = static_cast<unsigned>(std::min<size_t>(numThreads, std::max<size_t>(numNodes, 1)));
+
+    // Each thread takes the next source: every row is written by one thread only
+    std::atomic<size_t> nextSource(0);
+    auto worker = [&]() {
+        for (size_t source = nextSource++; source < numNodes; source = nextSource++) {
+            dijkstraFromSource(graph, static_cast<int>(source),
+                               distances.data() + source * numNodes,
+                               times.data() + source * numNodes,
+                               predecessors.data() + source * numNodes);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ShortestPaths shortestPaths;
+    shortestPaths.distances = DistanceMatrix(numNodes, std::move(distances));
+    shortestPaths.times = DistanceMatrix(numNodes, std::move(times));
+    shortestPaths.predecessors = std::move(predecessors);
+    return shortestPaths;
+}
+
+
+// ----------------- Problem instance class -----------------
+
+// Components of a ProblemInstance: the constructors load the ones of the mask, the others are
+// loaded the first time their getter is called (the nodes are always loaded, the index needs them).
+// The nearest neighbours are derived from the distances: they are read from the binary instance file
+// when it has them, otherwise they are computed, so they are not part of LOAD_ALL.
+enum LoadComponent : unsigned {
+    LOAD_DISTANCES = 1u << 0,
+    LOAD_TIMES = 1u << 1,
+    LOAD_EDGES = 1u << 2,
+    LOAD_NEIGHBORS = 1u << 3,
+    LOAD_ALL = LOAD_DISTANCES | LOAD_TIMES | LOAD_EDGES
+};
+
+// Where the deferred components of a ProblemInstance are loaded from, and which ones are loaded
+struct DeferredComponents {
+    std::atomic<unsigned> loaded{0};
+    std::mutex mutex;
+    MatrixPrecision precision = MatrixPrecision::Double;
+    std::shared_ptr<const MappedFile> instanceFile; // Binary instance (nullptr for the CSV files)
+    bool neighborsInFile = false; // The nearest neighbours of the binary instance match the distances
+    std::string distanceMatrixPath;
+    std::string timeMatrixPath;
+    std::string edgesMatrixPath;
+
+    DeferredComponents() = default;
+
+    // A copy gets its own mutex
+    DeferredComponents(const DeferredComponents& other) {
+        *this = other;
+    }
+
+    DeferredComponents& operator=(const DeferredComponents& other) {
+        loaded.store(other.loaded.load());
+        precision = other.precision;
+        instanceFile = other.instanceFile;
+        neighborsInFile = other.neighborsInFile;
+        distanceMatrixPath = other.distanceMatrixPath;
+        timeMatrixPath = other.timeMatrixPath;
+        edgesMatrixPath = other.edgesMatrixPath;
+        return *this;
+    }
+};
+
+// Class to encapsulate problem instance
+class ProblemInstance {
+public:
+    // The matrices can be loaded on first access (see LoadComponent): use the getters
+    mutable DistanceMatrix distancesMatrix;
+    mutable DistanceMatrix timesMatrix;
+    std::vector<NodeDataRow> nodesMatrix;
+    mutable std::vector<EdgeDataRow> edgesMatrix;
+    mutable NearestNeighbors nearestNeighbors;
+    int numberOfBuses;  // New variable: number of available buses
+    std::vector<int> busCapacities;  // New variable: capacity of each bus
+    std::vector<int> predecessorsMatrix; // Filled by buildMatricesFromEdges (n x n, see ShortestPaths)
+
+    // Index of the nodes, built once at load (see buildNodeIndex)
+    std::vector<int> nodeRowById; // Node id -> row of nodesMatrix (-1 if there is no such node)
+    DemandMatrix demandMatrix; // Row of the nodes matrix -> children to each school
+    std::vector<int> totalDemandById; // Node id -> sum of the children to all the clusters
+    std::vector<int> clusterIdByOrdinal; // x -> id of the x-th "cluster" node (x is 1-based, position 0 is unused)
+    std::vector<int> clusterOrdinalById; // Node id -> x if it is the x-th "cluster" node (-1 otherwise)
+    int depotId; // Id of the depot (-1 if there is none)
+    std::vector<int> busStopIds; // Ids of the bus stops, in the order of nodesMatrix
+    std::vector<int> clusterIds; // Ids of the clusters, in the order of nodesMatrix
+
+    ProblemInstance(const std::string& folderPath,
+                    const std::string& distanceMatrixFile,
+                    const std::string& timeMatrixFile,
+                    const std::string& nodesMatrixFile,
+                    const std::string& edgesMatrixFile,
+                    int numBuses,
+                    const std::vector<int>& capacities,
+                    MatrixPrecision precision = MatrixPrecision::Double,
+                    unsigned components = LOAD_ALL)
+    {
+        deferred.precision = precision;
+        deferred.distanceMatrixPath = folderPath + "/" + distanceMatrixFile;
+        deferred.timeMatrixPath = folderPath + "/" + timeMatrixFile;
+        deferred.edgesMatrixPath = folderPath + "/" + edgesMatrixFile;
+        loadComponents(components);
+
+        nodesMatrix = readNodesCSV(folderPath + "/" + nodesMatrixFile);
+        numberOfBuses = numBuses;
+        busCapacities = capacities;
+        buildNodeIndex();
+    }
+
+    // Constructor from a binary instance file (see compileInstance): the matrices are used in place
+    // (with a reduced precision they are converted once into owned buffers)
+    ProblemInstance(const std::string& instanceFile,
+                    int numBuses,
+                    const std::vector<int>& capacities,
+                    MatrixPrecision precision = MatrixPrecision::Double,
+                    unsigned components = LOAD_ALL)
+    {
+        std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(instanceFile);
+        const InstanceFileHeader& header = readInstanceFileHeader(*file);
+
+        deferred.precision = precision;
+        deferred.instanceFile = file;
+        deferred.neighborsInFile = header.numNeighbors > 0;
+        loadComponents(components);
+
+        // The nodes are small: they are decoded into the usual vector
+        const NodeFileRecord* nodes = reinterpret_cast<const NodeFileRecord*>(file->data + header.nodesOffset);
+        const int32_t* demands = reinterpret_cast<const int32_t*>(file->data + header.demandsOffset);
+        nodesMatrix.reserve(header.numNodes);
+        for (uint64_t i = 0; i < header.numNodes; ++i) {
+            NodeDataRow row;
+            row.id1 = nodes[i].id1;
+            row.id2 = nodes[i].id2;
+            row.id3 = nodes[i].id3;
+            row.latitude = nodes[i].latitude;
+            row.longitude = nodes[i].longitude;
+            row.type = static_cast<NodeType>(nodes[i].type);
+            row.children_to_cluster.assign(demands + i * header.numSchools, demands + (i + 1) * header.numSchools);
+            nodesMatrix.push_back(std::move(row));
+        }
+
+        numberOfBuses = numBuses;
+        busCapacities = capacities;
+        buildNodeIndex();
+    }
+
+    // Method to build the index of the nodes: dense id -> row table, demand matrix and total demand
+    // of each node, ordinal -> cluster id table. Every node is found by any of its three ids
+    // (the first row wins, as with a scan of nodesMatrix).
+    void buildNodeIndex() {
+        int maxId = -1;
+        for (const auto& node : nodesMatrix) {
+            maxId = std::max({maxId, node.id1, node.id2, node.id3});
+        }
+
+        const int numSchools = countNodeClusters(nodesMatrix);
+        demandMatrix = DemandMatrix(nodesMatrix.size(), numSchools);
+
+        nodeRowById.assign(maxId + 1, -1);
+        totalDemandById.assign(maxId + 1, -1);
+        clusterIdByOrdinal.assign(1, -1);
+        clusterOrdinalById.assign(maxId + 1, -1);
+        depotId = -1;
+        busStopIds.clear();
+        clusterIds.clear();
+
+        for (size_t row = 0; row < nodesMatrix.size(); ++row) {
+            const NodeDataRow& node = nodesMatrix[row];
+            std::copy(node.children_to_cluster.begin(), node.children_to_cluster.end(), demandMatrix.row(row));
+            int demand = totalSchoolLoad(demandMatrix.row(row), numSchools);
+            for (int id : {node.id1, node.id2, node.id3}) {
+                if (id >= 0 && nodeRowById[id] == -1) {
+                    nodeRowById[id] = static_cast<int>(row);
+                    totalDemandById[id] = demand;
+                }
+            }
+            switch (node.type) {
+                case NodeType::Depot:
+                    depotId = node.id1; // With more than one depot the last one is used
+                    break;
+                case NodeType::BusStop:
+                    busStopIds.push_back(node.id1);
+                    break;
+                case NodeType::Cluster:
+                    clusterIds.push_back(node.id1);
+                    clusterIdByOrdinal.push_back(node.id1);
+                    if (node.id1 >= 0 && clusterOrdinalById[node.id1] == -1) {
+                        clusterOrdinalById[node.id1] = static_cast<int>(clusterIdByOrdinal.size()) - 1;
+                    }
+                    break;
+            }
+        }
+    }
+
+    // Getter methods for the ids of the depot, of the bus stops and of the clusters
+    int getDepotID() const {
+        return depotId;
+    }
+
+    const std::vector<int>& getBusStopIDs() const {
+        return busStopIds;
+    }
+
+    const std::vector<int>& getClusterIDs() const {
+        return clusterIds;
+    }
+
+    // Method to get the node with the given id (nullptr if there is no such node)
+    const NodeDataRow* findNode(int nodeId) const {
+        if (nodeId < 0 || static_cast<size_t>(nodeId) >= nodeRowById.size() || nodeRowById[nodeId] == -1) {
+            return nullptr;
+        }
+        return &nodesMatrix[nodeRowById[nodeId]];
+    }
+
+    // Method to get the number of schools (clusters) of the instance
+    int getNumberOfSchools() const {
+        return demandMatrix.getNumberOfSchools();
+    }
+
+    const DemandMatrix& getDemandMatrix() const {
+        return demandMatrix;
+    }
+
+    // Method to get the children of a node to each school (nullptr if there is no such node)
+    const int* getNodeDemands(int nodeId) const {
+        if (nodeId < 0 || static_cast<size_t>(nodeId) >= nodeRowById.size() || nodeRowById[nodeId] == -1) {
+            return nullptr;
+        }
+        return demandMatrix.row(nodeRowById[nodeId]);
+    }
+
+    // Method to get the sum of the children to all the clusters of a node (-1 if there is no such node)
+    int getNodeTotalDemand(int nodeId) const {
+        if (nodeId < 0 || static_cast<size_t>(nodeId) >= totalDemandById.size()) {
+            return -1;
+        }
+        return totalDemandById[nodeId];
+    }
+
+    // Method to get the id of the x-th cluster (x is 1-based, -1 if there are less than x clusters)
+    int getClusterID(int x) const {
+        if (x < 1 || static_cast<size_t>(x) >= clusterIdByOrdinal.size()) {
+            return -1;
+        }
+        return clusterIdByOrdinal[x];
+    }
+
+    // Method to get x if the node is the x-th cluster (-1 if it is not a cluster)
+    int getClusterOrdinal(int nodeId) const {
+        if (nodeId < 0 || static_cast<size_t>(nodeId) >= clusterOrdinalById.size()) {
+            return -1;
+        }
+        return clusterOrdinalById[nodeId];
+    }
+
+    // Method to load the components of the mask that are not loaded yet (safe to call from many threads)
+    void loadComponents(unsigned components) const {
+        if ((deferred.loaded.load(std::memory_order_acquire) & components) == components) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(deferred.mutex);
+        for (unsigned component : {LOAD_DISTANCES, LOAD_TIMES, LOAD_EDGES, LOAD_NEIGHBORS}) {
+            if ((components & component) != 0 && (deferred.loaded.load(std::memory_order_relaxed) & component) == 0) {
+                loadComponent(component);
+                deferred.loaded.fetch_or(component, std::memory_order_release);
+            }
+        }
+    }
+
+    // Method to check if a component is loaded
+    bool isLoaded(unsigned component) const {
+        return (deferred.loaded.load(std::memory_order_acquire) & component) == component;
+    }
+
+    // Method to print all the matrices
+    void printMatrices() const {
+        loadComponents(LOAD_ALL);
+        std::cout << "Distance Matrix:" << std::endl;
+        printSquaredMatrix(distancesMatrix);
+
+        std::cout << std::endl; // Print an empty line
+
+        std::cout << "Time Matrix:" << std::endl;
+        printSquaredMatrix(timesMatrix);
+
+        std::cout << std::endl; // Print an empty line
+
+        std::cout << "Nodes Matrix:" << std::endl;
+        printNodesMatrix(nodesMatrix);
+
+        std::cout << std::endl; // Print an empty line
+
+        std::cout << "Edges Matrix:" << std::endl;
+        printEdgesMatrix(edgesMatrix);
+    }
+
+    // Getter and setter methods for distancesMatrix
+    const DistanceMatrix& getDistancesMatrix() const {
+        loadComponents(LOAD_DISTANCES);
+        return distancesMatrix;
+    }
+
+    void setDistancesMatrix(const DistanceMatrix& newMatrix) {
+        distancesMatrix = newMatrix;
+        deferred.loaded.fetch_or(LOAD_DISTANCES);
+        invalidateNearestNeighbors();
+    }
+
+    // Getter and setter methods for timesMatrix
+    const DistanceMatrix& getTimesMatrix() const {
+        loadComponents(LOAD_TIMES);
+        return timesMatrix;
+    }
+
+    void setTimesMatrix(const DistanceMatrix& newMatrix) {
+        timesMatrix = newMatrix;
+        deferred.loaded.fetch_or(LOAD_TIMES);
+    }
+
+    // Getter and setter methods for nodesMatrix
+    const std::vector<NodeDataRow>& getNodesMatrix() const {
+        return nodesMatrix;
+    }
+
+    void setNodesMatrix(const std::vector<NodeDataRow>& newData) {
+        nodesMatrix = newData;
+        buildNodeIndex();
+    }
+
+    // Getter and setter methods for edgesMatrix
+    const std::vector<EdgeDataRow>& getEdgesMatrix() const {
+        loadComponents(LOAD_EDGES);
+        return edgesMatrix;
+    }
+
+    void setEdgesMatrix(const std::vector<EdgeDataRow>& newData) {
+        edgesMatrix = newData;
+        deferred.loaded.fetch_or(LOAD_EDGES);
+    }
+
+    // Getter method for the nearest neighbours of every node (see NearestNeighbors)
+    const NearestNeighbors& getNearestNeighbors() const {
+        loadComponents(LOAD_NEIGHBORS);
+        return nearestNeighbors;
+    }
+
+    // Additional methods to write matrices to CSV files
+    void writeDistancesMatrix(const std::string& filePath) const {
+        writeSquaredCSV(filePath, getDistancesMatrix());
+    }
+
+    void writeTimesMatrix(const std::string& filePath) const {
+        writeSquaredCSV(filePath, getTimesMatrix());
+    }
+
+    void writeNodesMatrix(const std::string& filePath) const {
+        writeNodesCSV(filePath, nodesMatrix);
+    }
+
+    void writeEdgesMatrix(const std::string& filePath) const {
+        writeEdgesCSV(filePath, getEdgesMatrix());
+    }
+
+    // Method to rebuild distancesMatrix and timesMatrix from edgesMatrix (shortest paths by distance)
+    // It also stores the predecessors, so that the paths can be expanded with expandPath
+    void buildMatricesFromEdges(unsigned numThreads = 0) {
+        ShortestPaths shortestPaths = computeAllPairsShortestPaths(getEdgesMatrix(), nodesMatrix.size(), numThreads);
+        distancesMatrix = std::move(shortestPaths.distances);
+        timesMatrix = std::move(shortestPaths.times);
+        predecessorsMatrix = std::move(shortestPaths.predecessors);
+        deferred.loaded.fetch_or(LOAD_DISTANCES | LOAD_TIMES);
+        invalidateNearestNeighbors();
+    }
+
+    // Method to expand the road path from node "from" to node "to" (needs buildMatricesFromEdges)
+    std::vector<int> expandPath(int from, int to) const {
+        if (predecessorsMatrix.empty()) {
+            throw std::runtime_error("No predecessors: call buildMatricesFromEdges first");
+        }
+        return expandShortestPath(predecessorsMatrix, getDistancesMatrix().size(), from, to);
+    }
+
+    // Method to write the whole instance (with the nearest neighbours) to a binary instance file
+    void writeInstance(const std::string& filePath, uint64_t sourceHash = 0) const {
+        loadComponents(LOAD_ALL | LOAD_NEIGHBORS);
+        writeInstanceFile(filePath, distancesMatrix, timesMatrix, nodesMatrix, edgesMatrix, nearestNeighbors, sourceHash);
+    }
+
+    // Getter method for numberOfBuses
+    int getNumberOfBuses() const {
+        return numberOfBuses;
+    }
+
+    // Setter method for numberOfBuses
+    void setNumberOfBuses(int numBuses) {
+        numberOfBuses = numBuses;
+    }
+
+    // Getter method for busesCapacity
+    const std::vector<int>& getBusesCapacity() const {
+        return busCapacities;
+    }
+
+    // Setter method for busesCapacity
+    void setBusesCapacity(const std::vector<int>& capacities) {
+        busCapacities = capacities;
+    }
+
+private:
+    mutable DeferredComponents deferred;
+
+    // Method to compute the nearest neighbours again after the distances are changed
+    void invalidateNearestNeighbors() {
+        deferred.neighborsInFile = false;
+        deferred.loaded.fetch_and(~static_cast<unsigned>(LOAD_NEIGHBORS));
+    }
+
+    // Method to load one component from the CSV files or from the binary instance file
+    void loadComponent(unsigned component) const {
+        const MatrixPrecision precision = deferred.precision;
+
+        if (component == LOAD_NEIGHBORS && !deferred.neighborsInFile) {
+            if ((deferred.loaded.load(std::memory_order_relaxed) & LOAD_DISTANCES) == 0) {
+                loadComponent(LOAD_DISTANCES);
+                deferred.loaded.fetch_or(LOAD_DISTANCES, std::memory_order_release);
+            }
+            nearestNeighbors = computeNearestNeighbors(distancesMatrix);
+            return;
+        }
+
+        if (deferred.instanceFile == nullptr) {
+            switch (component) {
+                case LOAD_DISTANCES:
+                    distancesMatrix = readSquaredCSV(deferred.distanceMatrixPath, precision, DISTANCE_FIXED_POINT_SCALE);
+                    break;
+                case LOAD_TIMES:
+                    timesMatrix = readSquaredCSV(deferred.timeMatrixPath, precision, TIME_FIXED_POINT_SCALE);
+                    break;
+                case LOAD_EDGES:
+                    edgesMatrix = readEdgesCSV(deferred.edgesMatrixPath);
+                    break;
+            }
+            return;
+        }
+
+        // The pages of a section of the mapped file are only read when the section is used
+        const MappedFile& file = *deferred.instanceFile;
+        const InstanceFileHeader& header = readInstanceFileHeader(file);
+        switch (component) {
+            case LOAD_DISTANCES:
+                distancesMatrix = DistanceMatrix(header.matrixSize, reinterpret_cast<const double*>(file.data + header.distancesOffset), deferred.instanceFile);
+                if (precision != MatrixPrecision::Double) {
+                    distancesMatrix = distancesMatrix.withPrecision(precision, DISTANCE_FIXED_POINT_SCALE);
+                }
+                break;
+            case LOAD_TIMES:
+                timesMatrix = DistanceMatrix(header.matrixSize, reinterpret_cast<const double*>(file.data + header.timesOffset), deferred.instanceFile);
+                if (precision != MatrixPrecision::Double) {
+                    timesMatrix = timesMatrix.withPrecision(precision, TIME_FIXED_POINT_SCALE);
+                }
+                break;
+            case LOAD_EDGES: {
+                const EdgeFileRecord* edges = reinterpret_cast<const EdgeFileRecord*>(file.data + header.edgesOffset);
+                edgesMatrix.clear();
+                edgesMatrix.reserve(header.numEdges);
+                for (uint64_t i = 0; i < header.numEdges; ++i) {
+                    edgesMatrix.push_back({edges[i].source, edges[i].target, edges[i].weight, edges[i].time});
+                }
+                break;
+            }
+            case LOAD_NEIGHBORS: {
+                const int32_t* ids = reinterpret_cast<const int32_t*>(file.data + header.neighborsOffset);
+                nearestNeighbors.numNodes = header.matrixSize;
+                nearestNeighbors.k = header.numNeighbors;
+                nearestNeighbors.ids.assign(ids, ids + header.matrixSize * header.numNeighbors);
+                break;
+            }
+        }
+    }
+
+};
+
+// ----------------- Instance cache -----------------
+
+// Function to hash the content of a file (FNV-1a on 64 bit words), chained to the hash of the previous files
+inline uint64_t hashFileContent(const std::string& filePath, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const uint64_t prime = 0x100000001b3ULL;
+    MappedFile file(filePath);
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= file.size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, file.data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < file.size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(file.data[i])) * prime;
+    }
+    // The size separates the files, so that moving bytes from one file to the next changes the hash
+    return (hash ^ file.size) * prime;
+}
+
+// Function to get the name prefix of the cached files of four CSV files ("<distance>+<time>+<nodes>+<edges>-"),
+// with the path separators replaced
+inline std::string cachedInstancePrefix(const std::string& distanceMatrixFile,
+                                        const std::string& timeMatrixFile,
+                                        const std::string& nodesMatrixFile,
+                                        const std::string& edgesMatrixFile) {
+    std::string prefix;
+    for (const std::string& file : {distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile}) {
+        if (!prefix.empty()) prefix += '+';
+        std::string stem = std::filesystem::path(file).replace_extension().string();
+        std::replace(stem.begin(), stem.end(), '/', '_');
+        std::replace(stem.begin(), stem.end(), '\\', '_');
+        prefix += stem;
+    }
+    return prefix + "-";
+}
+
+// Function to get the binary instance of a CSV folder from the instance cache, compiling it if needed.
+// The cached file is named after the four CSV files and the hash of their content (and of the format
+// version), so any change to them invalidates it. The cache folder is <folder>/.sbrp_cache unless given.
+inline std::string cachedInstanceFile(const std::string& folderPath,
+                                      const std::string& distanceMatrixFile,
+                                      const std::string& timeMatrixFile,
+                                      const std::string& nodesMatrixFile,
+                                      const std::string& edgesMatrixFile,
+                                      const std::string& cacheFolder = "") {
+    namespace fs = std::filesystem;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const std::string& file : {distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile}) {
+        hash = hashFileContent(folderPath + "/" + file, hash);
+    }
+    hash = (hash ^ INSTANCE_FILE_VERSION) * 0x100000001b3ULL;
+
+    const bool defaultFolder = cacheFolder.empty();
+    fs::path folder = defaultFolder ? fs::path(folderPath) / ".sbrp_cache" : fs::path(cacheFolder);
+    const std::string prefix = cachedInstancePrefix(distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.sbrp", static_cast<unsigned long long>(hash));
+    fs::path cached = folder / (prefix + name);
+
+    if (fs::exists(cached)) {
+        try {
+            MappedFile file(cached.string());
+            if (readInstanceFileHeader(file).sourceHash == hash) {
+                return cached.string();
+            }
+        } catch (const std::runtime_error&) {
+            // Unreadable or truncated: it is compiled again
+        }
+    }
+
+    fs::create_directories(folder);
+    ProblemInstance problemInstance(folderPath, distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile, 0, {});
+
+    // Written under a temporary name and then renamed, so that a concurrent run never maps a half written file
+    fs::path temporary = cached;
+    temporary += "." + std::to_string(::getpid()) + ".tmp";
+    problemInstance.writeInstance(temporary.string(), hash);
+    fs::rename(temporary, cached);
+
+    // The files of the folder cache with the same CSV files and another hash are older versions of them.
+    // The files of other CSV files of the folder are kept.
+    if (defaultFolder) {
+        for (const auto& entry : fs::directory_iterator(folder)) {
+            const std::string entryName = entry.path().filename().string();
+            if (entryName.size() == prefix.size() + std::strlen(name) && entryName.compare(0, prefix.size(), prefix) == 0 &&
+                entry.path().extension() == ".sbrp" && entry.path() != cached) {
+                std::error_code error;
+                fs::remove(entry.path(), error);
+            }
+        }
+    }
+
+    return cached.string();
+}
+
+#endif // PROBLEMINSTANCE_H
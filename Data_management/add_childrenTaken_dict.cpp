@@ -388,8 +388,10 @@ struct Route {
     int childrenToCluster3;
     int childrenToCluster4;
 
-    // New field: children taken dictionary
-    std::unordered_map<int, std::vector<int>> childrenTakenDictionary;
+    // New field: children taken at each node, as a flat array (one entry per node, no hash map to copy with the route):
+    // childrenTakenNodes[e] is the node and childrenTaken[4 * e + k] are its children to cluster k + 1
+    std::vector<int> childrenTakenNodes;
+    std::vector<int> childrenTaken;
 
     // Constructor to initialize the variables
     Route(int index) 
@@ -400,6 +402,18 @@ struct Route {
           childrenToCluster4(0) {}
 };
 
+// Function to add the children taken at a node to a route (to the entry of the node, if the route already has it)
+void addChildrenTaken(Route& route, int nodeId, const std::vector<int>& children) {
+    size_t e = std::find(route.childrenTakenNodes.begin(), route.childrenTakenNodes.end(), nodeId) - route.childrenTakenNodes.begin();
+    if (e == route.childrenTakenNodes.size()) {
+        route.childrenTakenNodes.push_back(nodeId);
+        route.childrenTaken.resize(route.childrenTaken.size() + 4, 0);
+    }
+    for (size_t k = 0; k < 4 && k < children.size(); ++k) {
+        route.childrenTaken[4 * e + k] += children[k];
+    }
+}
+
 // Function to print the route
 void printRoute(const Route& route) {
     std::cout << "\nBus: " << route.busIndex << std::endl;
@@ -413,14 +427,12 @@ void printRoute(const Route& route) {
     std::cout << "-- Children to cluster 3: " << route.childrenToCluster3 << std::endl;
     std::cout << "-- Children to cluster 4: " << route.childrenToCluster4 << std::endl;
 
-    std::cout << "- Children Taken Dictionary: " << std::endl;
-    for (const auto& entry : route.childrenTakenDictionary) {
-        int nodeId = entry.first;
-        const std::vector<int>& childrenCounts = entry.second;
-        std::cout << "-- Node ID: " << nodeId << " -> [";
-        for (size_t i = 0; i < childrenCounts.size(); ++i) {
-            std::cout << childrenCounts[i];
-            if (i < childrenCounts.size() - 1) {
+    std::cout << "- Children Taken: " << std::endl;
+    for (size_t e = 0; e < route.childrenTakenNodes.size(); ++e) {
+        std::cout << "-- Node ID: " << route.childrenTakenNodes[e] << " -> [";
+        for (size_t k = 0; k < 4; ++k) {
+            std::cout << route.childrenTaken[4 * e + k];
+            if (k < 3) {
                 std::cout << ", ";
             }
         }
@@ -1397,9 +1409,9 @@ int main() {
     route1.childrenToCluster2 = 5;
     // Add the visited nodes
     route1.visitedNodes = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
-    // Add the dcitonary of children taken
-    route1.childrenTakenDictionary[1] = {10,0,0,0};
-    route1.childrenTakenDictionary[2] = {0,5,0,0};
+    // Add the children taken at each node
+    addChildrenTaken(route1, 1, {10,0,0,0});
+    addChildrenTaken(route1, 2, {0,5,0,0});
 
     // Print the route 
     printRoute(route1); 
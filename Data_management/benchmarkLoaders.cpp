@@ -0,0 +1,125 @@
+/**
+ * @file benchmarkLoaders.cpp
+ * @brief Micro-benchmark of the CSV loaders of ProblemInstance.h.
+ *
+ * It writes a synthetic n x n matrix in the same format of the clean data
+ * (first row and first column are the indices, "nan" in the corner), then it reads it
+ * with readSquaredCSV and with the old split + std::stod reader and it reports MB/s.
+ *
+ * Usage: ./benchmarkLoaders [n] [file]
+ * Default: n = 5000, file = /tmp/benchmark_matrix.csv
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono> // For std::chrono::steady_clock
+#include <cstdio> // For std::remove
+
+#include "ProblemInstance.h"
+
+// Function to write a synthetic distance matrix CSV of size n (n+1 rows and columns with the indices)
+void writeSyntheticMatrixCSV(const std::string& filePath, int n) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dis(0.0, 5000.0);
+
+    file << std::fixed << std::setprecision(1);
+    file << "nan";
+    for (int j = 0; j < n; ++j) {
+        file << "," << static_cast<double>(j);
+    }
+    file << "\n";
+
+    for (int i = 0; i < n; ++i) {
+        file << static_cast<double>(i);
+        for (int j = 0; j < n; ++j) {
+            file << "," << (i == j ? 0.0 : dis(gen));
+        }
+        file << "\n";
+    }
+
+    file.close();
+}
+
+// Old reader (split + std::stod), kept here as the reference of the benchmark
+std::vector<std::vector<double>> readSquaredCSVWithSplit(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file");
+    }
+
+    std::vector<std::vector<double>> matrix;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::vector<std::string> tokens;
+        std::string token;
+        std::istringstream tokenStream(line);
+        while (std::getline(tokenStream, token, ',')) {
+            tokens.push_back(token);
+        }
+        std::vector<double> row;
+        for (const std::string& token : tokens) {
+            row.push_back(std::stod(token));
+        }
+        matrix.push_back(row);
+    }
+
+    file.close();
+    return matrix;
+}
+
+// Function to time a loader and print its throughput
+template <typename Loader>
+double timeLoader(const std::string& name, double fileMegabytes, Loader loader) {
+    auto start = std::chrono::steady_clock::now();
+    double checksum = loader();
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+
+    std::cout << std::left << std::setw(24) << name
+              << std::fixed << std::setprecision(3) << seconds << " s  "
+              << std::setprecision(1) << fileMegabytes / seconds << " MB/s"
+              << "  (checksum " << std::setprecision(1) << checksum << ")" << std::endl;
+    return seconds;
+}
+
+
+int main(int argc, char* argv[]) {
+    int n = (argc > 1) ? std::stoi(argv[1]) : 5000;
+    std::string filePath = (argc > 2) ? argv[2] : "/tmp/benchmark_matrix.csv";
+
+    std::cout << "Writing a synthetic " << n << "x" << n << " matrix to " << filePath << std::endl;
+    writeSyntheticMatrixCSV(filePath, n);
+
+    std::ifstream sizeCheck(filePath, std::ios::binary | std::ios::ate);
+    double fileMegabytes = static_cast<double>(sizeCheck.tellg()) / (1024.0 * 1024.0);
+    sizeCheck.close();
+    std::cout << "File size: " << std::fixed << std::setprecision(1) << fileMegabytes << " MB\n" << std::endl;
+
+    // The checksum (sum of the distances from each node to the next one) makes sure that the two loaders read the same data
+    double streamingSeconds = timeLoader("from_chars (current)", fileMegabytes, [&]() {
+        DistanceMatrix matrix = readSquaredCSV(filePath);
+        double sum = 0.0;
+        for (size_t i = 0; i < matrix.size(); ++i) sum += matrix.at(i, (i + 1) % matrix.size());
+        return sum;
+    });
+
+    double splitSeconds = timeLoader("split + stod (old)", fileMegabytes, [&]() {
+        std::vector<std::vector<double>> matrix = readSquaredCSVWithSplit(filePath);
+        double sum = 0.0;
+        for (size_t i = 1; i < matrix.size(); ++i) sum += matrix[i][(i % (matrix.size() - 1)) + 1];
+        return sum;
+    });
+
+    std::cout << "\nSpeedup: " << std::setprecision(2) << splitSeconds / streamingSeconds << "x" << std::endl;
+
+    std::remove(filePath.c_str());
+    return 0;
+}
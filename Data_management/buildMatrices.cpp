@@ -0,0 +1,79 @@
+/**
+ * @file buildMatrices.cpp
+ * @brief Build the distance and time matrices of a clean CSV folder from its edges matrix.
+ *
+ * It runs Dijkstra from every node of the road graph (<name>_edges.csv), in parallel,
+ * and it writes <name>_distanceMatrix.csv, <name>_timeMatrix.csv and <name>_predecessors.csv
+ * in the output folder. The predecessors matrix allows to expand the road path between two nodes:
+ * row s, column t is the node before t on the shortest path from s to t (-1 if none).
+ *
+ * Usage: ./buildMatrices <folder> <output folder> [threads]
+ * Example: ./buildMatrices BUTTRIO BUTTRIO_rebuilt 4
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono> // For std::chrono::steady_clock
+
+#include "ProblemInstance.h"
+
+// Function to write the predecessors matrix to a CSV file (one row per source node, no header)
+void writePredecessorsCSV(const std::string& filePath, const std::vector<int>& predecessors, size_t n) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing");
+    }
+
+    for (size_t s = 0; s < n; ++s) {
+        for (size_t t = 0; t < n; ++t) {
+            file << predecessors[s * n + t];
+            if (t != n - 1) {
+                file << ",";
+            }
+        }
+        file << "\n";
+    }
+
+    file.close();
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <folder> <output folder> [threads]" << std::endl;
+        return 1;
+    }
+
+    std::string folderPath = argv[1];
+    std::string outputFolder = argv[2];
+    unsigned numThreads = (argc > 3) ? static_cast<unsigned>(std::stoi(argv[3])) : 0;
+
+    try {
+        std::string nodesMatrixFile = findFileWithSuffix(folderPath, "_nodes.csv");
+        std::string edgesMatrixFile = findFileWithSuffix(folderPath, "_edges.csv");
+        std::string name = nodesMatrixFile.substr(0, nodesMatrixFile.size() - std::string("_nodes.csv").size());
+
+        std::vector<NodeDataRow> nodesMatrix = readNodesCSV(folderPath + "/" + nodesMatrixFile);
+        std::vector<EdgeDataRow> edgesMatrix = readEdgesCSV(folderPath + "/" + edgesMatrixFile);
+
+        auto start = std::chrono::steady_clock::now();
+        ShortestPaths shortestPaths = computeAllPairsShortestPaths(edgesMatrix, nodesMatrix.size(), numThreads);
+        auto stop = std::chrono::steady_clock::now();
+
+        std::cout << "Shortest paths of " << nodesMatrix.size() << " nodes and " << edgesMatrix.size() << " edges in "
+                  << std::chrono::duration<double>(stop - start).count() << " s" << std::endl;
+
+        std::filesystem::create_directories(outputFolder);
+        writeSquaredCSV(outputFolder + "/" + name + "_distanceMatrix.csv", shortestPaths.distances);
+        writeSquaredCSV(outputFolder + "/" + name + "_timeMatrix.csv", shortestPaths.times);
+        writePredecessorsCSV(outputFolder + "/" + name + "_predecessors.csv", shortestPaths.predecessors, nodesMatrix.size());
+
+        std::cout << "Matrices written to " << outputFolder << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file compileInstance.cpp
+ * @brief Compile a clean CSV data folder (e.g. BUTTRIO) into one binary instance file.
+ *
+ * The folder must contain the four files produced by the python functions:
+ * <name>_distanceMatrix.csv, <name>_timeMatrix.csv, <name>_nodes.csv and <name>_edges.csv.
+ * The output can be given to the solver in place of the CSV folder, it is mapped in memory.
+ *
+ * Usage: ./compileInstance <folder> <output file>
+ * Example: ./compileInstance BUTTRIO BUTTRIO/buttrio.sbrp
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ProblemInstance.h"
+
+// Function to check that two matrices are identical
+bool sameMatrix(const DistanceMatrix& a, const DistanceMatrix& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    return std::memcmp(a.values(), b.values(), a.size() * a.size() * sizeof(double)) == 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <folder> <output file>" << std::endl;
+        return 1;
+    }
+
+    std::string folderPath = argv[1];
+    std::string outputFile = argv[2];
+
+    try {
+        std::string distanceMatrixFile = findFileWithSuffix(folderPath, "_distanceMatrix.csv");
+        std::string timeMatrixFile = findFileWithSuffix(folderPath, "_timeMatrix.csv");
+        std::string nodesMatrixFile = findFileWithSuffix(folderPath, "_nodes.csv");
+        std::string edgesMatrixFile = findFileWithSuffix(folderPath, "_edges.csv");
+
+        // Buses are not part of the instance file: they are given to the solver
+        ProblemInstance problemInstance(folderPath, distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile, 0, {});
+        problemInstance.writeInstance(outputFile);
+
+        // Read the file back and check it
+        ProblemInstance compiled(outputFile, 0, {});
+        if (!sameMatrix(compiled.getDistancesMatrix(), problemInstance.getDistancesMatrix()) ||
+            !sameMatrix(compiled.getTimesMatrix(), problemInstance.getTimesMatrix()) ||
+            compiled.getNodesMatrix().size() != problemInstance.getNodesMatrix().size() ||
+            compiled.getEdgesMatrix().size() != problemInstance.getEdgesMatrix().size()) {
+            std::cerr << "Error: the compiled instance does not match the CSV files" << std::endl;
+            return 1;
+        }
+
+        std::cout << "Compiled " << folderPath << " into " << outputFile << " (version " << INSTANCE_FILE_VERSION << ")" << std::endl;
+        std::cout << "Matrices: " << compiled.getDistancesMatrix().size() << "x" << compiled.getDistancesMatrix().size()
+                  << ", nodes: " << compiled.getNodesMatrix().size()
+                  << ", edges: " << compiled.getEdgesMatrix().size() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -21,382 +21,189 @@
 #include <iomanip>   // For std::fixed, std::setprecision
 #include <numeric> // for std::accumulate
 #include <unordered_set> // For std::unordered_set
+#include <unordered_map> // For std::unordered_map
+#include <chrono> // For std::chrono::steady_clock
+#include <thread> // For std::thread
+#include <exception> // For std::exception_ptr
 
+#include "ProblemInstance.h"
 
-// ----------------- For all matrices -----------------
+// ----------------- Initialization -----------------
 
-// Function to split a string by a delimiter and return a vector of substrings
-std::vector<std::string> split(const std::string& s, char delimiter) {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(token);
-    }
-    return tokens;
+// Random engine of the construction procedures, one per thread: it is seeded from std::random_device,
+// unless seedRandomEngine is called (initializePopulation seeds one stream per worker)
+std::mt19937& randomEngine() {
+    thread_local std::mt19937 engine(std::random_device{}());
+    return engine;
 }
 
-
-// ----------------- Distance and Time matrices -----------------
-
-// Function to read a matrix CSV file and return a matrix of doubles
-std::vector<std::vector<double>> readSquaredCSV(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file");
-    }
-
-    std::vector<std::vector<double>> matrix;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::vector<std::string> tokens = split(line, ',');
-        std::vector<double> row;
-        for (const std::string& token : tokens) {
-            row.push_back(std::stod(token));
-        }
-        matrix.push_back(row);
-    }
-
-    file.close();
-    return matrix;
+// Function to seed the random engine of the calling thread
+void seedRandomEngine(uint32_t seed) {
+    randomEngine().seed(seed);
 }
 
-// Function to print a squared matrix
-void printSquaredMatrix(const std::vector<std::vector<double>>& matrix) {
-    for (const std::vector<double>& row : matrix) {
-        for (double value : row) {
-            std::cout << value << " ";
-        }
-        std::cout << std::endl;
-    }
+// Given a node ID, find the sum of children to clusters (precomputed at load, -1 if the node is not found)
+int sumChildrenToClusters(const ProblemInstance& problemInstance, int nodeId) {
+    return problemInstance.getNodeTotalDemand(nodeId);
 }
 
-// ----------------- Node matrix -----------------
-
-// Define a struct to hold the data for each row
-struct NodeDataRow {
-    int id1;
-    int id2;
-    int id3;
-    double latitude;
-    double longitude;
-    std::string type;
-    int children_to_cluster_1; // Number of children to cluster 1
-    int children_to_cluster_2; // Number of children to cluster 2
-    int children_to_cluster_3; // Number of children to cluster 3
-    int children_to_cluster_4; // Number of children to cluster 4
+// Time summaries of a route, filled by computeRouteTimes (the routes are depot -> bus stops -> schools)
+struct RouteTimes {
+    bool valid = false; // Cleared by every change of the route
+    double maxRideTime = 0.0; // Constraints the slacks and the violation were computed with
+    double schoolDeadline = 0.0;
+    std::vector<double> arrival; // Time from the depot to each position
+    std::vector<double> lastSchoolArrival; // For a stop: arrival at the last school of its children (-inf otherwise)
+    std::vector<double> rideSlack; // For a stop: maxRideTime minus its ride time (+inf otherwise)
+    std::vector<double> rideSlackPrefix; // Minimum of rideSlack from the depot up to each position
+    std::vector<double> deadlineSlackSuffix; // Minimum of schoolDeadline - arrival over the schools from each position on
+    std::vector<double> schoolArrival; // Arrival at each school (position k is school k + 1, -1 if it is not visited)
+    double weightedRideTime = 0.0; // Sum over the stops of children * time on the bus
+    double violation = 0.0; // Total time over maxRideTime and over schoolDeadline
 };
 
-// Function to read the CSV file and return a vector of DataRow structs
-std::vector<NodeDataRow> readNodesCSV(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file");
-    }
-
-    std::vector<NodeDataRow> data;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::vector<std::string> tokens = split(line, ',');
-        if (tokens.size() == 10) {
-            NodeDataRow row;
-            row.id1 = std::stoi(tokens[0]);
-            row.id2 = std::stoi(tokens[1]);
-            row.id3 = std::stoi(tokens[2]);
-            row.latitude = std::stod(tokens[3]);
-            row.longitude = std::stod(tokens[4]);
-            row.type = tokens[5];
-            row.children_to_cluster_1 = std::stoi(tokens[6]);
-            row.children_to_cluster_2 = std::stoi(tokens[7]);
-            row.children_to_cluster_3 = std::stoi(tokens[8]);
-            row.children_to_cluster_4 = std::stoi(tokens[9]);
-            data.push_back(row);
-        }
-    }
+// Struct to represent a Route
+struct Route {
+    int busIndex;
+    std::vector<int> visitedNodes; // Stores visited nodes
+    
+    // Number of children to each cluster (position k is cluster k + 1, only the first numSchools are used)
+    int numSchools;
+    SchoolLoads childrenToCluster;
 
-    file.close();
-    return data;
-}
+    // Cached distance of visitedNodes and sum of childrenToCluster, kept up to date by every function
+    // that changes the route (refreshRouteCache computes them again from scratch)
+    double cost;
+    int load;
 
-// Function to print the data matrix
-void printNodesMatrix(const std::vector<NodeDataRow>& dataMatrix) {
-    for (const NodeDataRow& row : dataMatrix) {
-        std::cout << row.id1 << " " << row.id2 << " " << row.id3 << " "
-                  << row.latitude << " " << row.longitude << " "
-                  << row.type << " " << row.children_to_cluster_1 << " " << row.children_to_cluster_2 << " "
-                  << row.children_to_cluster_3 << " " << row.children_to_cluster_4 << std::endl;
-    }
-}
+    // Children picked up at each bus stop of the route, one entry per stop: pickupStops[e] is the stop and
+    // pickupLoads[e * numSchools + k] are its children to cluster k + 1. A stop split among more buses has an entry
+    // in each of their routes with its part of the children. childrenToCluster and load are the sums of the entries.
+    std::vector<int> pickupStops;
+    std::vector<int> pickupLoads;
 
-// ----------------- Edges matrix -----------------
+    // Time summaries (only with the time-aware evaluation)
+    RouteTimes times;
 
-// Define a struct to hold the data for each row
-struct EdgeDataRow {
-    int source;
-    int target;
-    double weight;
-    double time;
+    // Constructor to initialize the variables
+    Route(int index, int schools) 
+        : busIndex(index), 
+          numSchools(schools),
+          childrenToCluster{},
+          cost(0.0),
+          load(0) {}
 };
 
-// Function to read the CSV file and return a vector of Edge structs
-std::vector<EdgeDataRow> readEdgesCSV(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file");
-    }
-
-    std::vector<EdgeDataRow> data;
-    std::string line;
-
-    // Skip the header line
-    std::getline(file, line);
+// Maximum number of routes that can serve the same bus stop (a stop with more children than a bus is split among buses)
+const int MAX_SPLITS_PER_STOP = 3;
 
-    while (std::getline(file, line)) {
-        std::vector<std::string> tokens = split(line, ',');
-        if (tokens.size() == 4) {
-            EdgeDataRow edge;
-            edge.source = std::stoi(tokens[0]);
-            edge.target = std::stoi(tokens[1]);
-            edge.weight = std::stod(tokens[2]);
-            edge.time = std::stod(tokens[3]);
-            data.push_back(edge);
+// Function to find the pickup entry of a bus stop in a route (-1 if the route does not serve it)
+int findPickup(const Route& route, int busStop) {
+    for (size_t e = 0; e < route.pickupStops.size(); ++e) {
+        if (route.pickupStops[e] == busStop) {
+            return static_cast<int>(e);
         }
     }
-
-    file.close();
-    return data;
+    return -1;
 }
 
-
-// Function to print the edge matrix
-void printEdgesMatrix(const std::vector<EdgeDataRow>& edgeMatrix) {
-    for (const EdgeDataRow& edge : edgeMatrix) {
-        std::cout << edge.source << " " << edge.target << " "
-                  << edge.weight << " " << edge.time << std::endl;
-    }
+// Children to each cluster picked up at the entry e of a route
+const int* getPickupLoads(const Route& route, int e) {
+    return route.pickupLoads.data() + static_cast<size_t>(e) * route.numSchools;
 }
 
-// ----------------- Write on csv functions -----------------
-
-// Function to write a matrix to a CSV file
-void writeSquaredCSV(const std::string& filePath, const std::vector<std::vector<double>>& matrix) {
-    std::ofstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file for writing");
-    }
-
-    for (const auto& row : matrix) {
-        for (size_t i = 0; i < row.size(); ++i) {
-            file << row[i];
-            if (i != row.size() - 1) {
-                file << ",";
-            }
-        }
-        file << std::endl;
-    }
-
-    file.close();
+// Function to add children of a bus stop to the pickups of a route (to the entry of the stop, if the route already serves it).
+// It does not change visitedNodes
+void addPickup(Route& route, int busStop, const int* loads) {
+    int e = findPickup(route, busStop);
+    if (e == -1) {
+        e = static_cast<int>(route.pickupStops.size());
+        route.pickupStops.push_back(busStop);
+        route.pickupLoads.resize(route.pickupLoads.size() + route.numSchools, 0);
+    }
+    addSchoolLoads(route.pickupLoads.data() + static_cast<size_t>(e) * route.numSchools, loads, route.numSchools);
+    addSchoolLoads(route.childrenToCluster.data(), loads, route.numSchools);
+    route.load += totalSchoolLoad(loads, route.numSchools);
+    route.times.valid = false;
 }
 
-// Function to write the NodeDataRow vector to a CSV file
-void writeNodesCSV(const std::string& filePath, const std::vector<NodeDataRow>& dataMatrix) {
-    std::ofstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file for writing");
-    }
-
-    for (const auto& row : dataMatrix) {
-        file << row.id1 << "," << row.id2 << "," << row.id3 << ","
-             << row.latitude << "," << row.longitude << ","
-             << row.type << "," << row.children_to_cluster_1 << "," << row.children_to_cluster_2 << ","
-             << row.children_to_cluster_3 << "," << row.children_to_cluster_4 << std::endl;
-    }
-
-    file.close();
+// Function to take children (at most the ones of the entry) away from the entry e of a route.
+// The entry is erased when no children are left; it returns true in that case. It does not change visitedNodes
+bool removePickup(Route& route, int e, const int* loads) {
+    int* entry = route.pickupLoads.data() + static_cast<size_t>(e) * route.numSchools;
+    subtractSchoolLoads(entry, loads, route.numSchools);
+    subtractSchoolLoads(route.childrenToCluster.data(), loads, route.numSchools);
+    route.load -= totalSchoolLoad(loads, route.numSchools);
+    route.times.valid = false;
+    if (totalSchoolLoad(entry, route.numSchools) > 0) {
+        return false;
+    }
+    route.pickupStops.erase(route.pickupStops.begin() + e);
+    route.pickupLoads.erase(route.pickupLoads.begin() + static_cast<size_t>(e) * route.numSchools,
+                            route.pickupLoads.begin() + static_cast<size_t>(e + 1) * route.numSchools);
+    return true;
 }
 
-// Function to write the EdgeDataRow vector to a CSV file
-void writeEdgesCSV(const std::string& filePath, const std::vector<EdgeDataRow>& edgeMatrix) {
-    std::ofstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file for writing");
-    }
-
-    file << "source,target,weight,time" << std::endl; // Write header line
-
-    for (const auto& edge : edgeMatrix) {
-        file << edge.source << "," << edge.target << ","
-             << edge.weight << "," << edge.time << std::endl;
+// Function to count the routes that serve a bus stop
+int countServingRoutes(const std::vector<Route>& routes, int busStop) {
+    int count = 0;
+    for (const Route& route : routes) {
+        count += (findPickup(route, busStop) != -1) ? 1 : 0;
     }
-
-    file.close();
+    return count;
 }
 
-// ----------------- Problem instance class -----------------
-
-// Class to encapsulate problem instance
-class ProblemInstance {
-public:
-    std::vector<std::vector<double>> distancesMatrix;
-    std::vector<std::vector<double>> timesMatrix;
-    std::vector<NodeDataRow> nodesMatrix;
-    std::vector<EdgeDataRow> edgesMatrix;
-    int numberOfBuses;  // New variable: number of available buses
-    std::vector<int> busCapacities;  // New variable: capacity of each bus
-
-    ProblemInstance(const std::string& folderPath, 
-                    const std::string& distanceMatrixFile,
-                    const std::string& timeMatrixFile,
-                    const std::string& nodesMatrixFile,
-                    const std::string& edgesMatrixFile,
-                    int numBuses,
-                    const std::vector<int>& capacities) 
-    {
-        distancesMatrix = readSquaredCSV(folderPath + "/" + distanceMatrixFile);
-        timesMatrix = readSquaredCSV(folderPath + "/" + timeMatrixFile);
-        nodesMatrix = readNodesCSV(folderPath + "/" + nodesMatrixFile);
-        edgesMatrix = readEdgesCSV(folderPath + "/" + edgesMatrixFile);
-        numberOfBuses = numBuses;
-        busCapacities = capacities;
-    }
-
-    // Method to print all the matrices
-    void printMatrices() const {
-        std::cout << "Distance Matrix:" << std::endl;
-        printSquaredMatrix(distancesMatrix);
-
-        std::cout << std::endl; // Print an empty line
-
-        std::cout << "Time Matrix:" << std::endl;
-        printSquaredMatrix(timesMatrix);
-
-        std::cout << std::endl; // Print an empty line
-
-        std::cout << "Nodes Matrix:" << std::endl;
-        printNodesMatrix(nodesMatrix);
-
-        std::cout << std::endl; // Print an empty line
-
-        std::cout << "Edges Matrix:" << std::endl;
-        printEdgesMatrix(edgesMatrix);
-    }
-
-    // Getter and setter methods for distancesMatrix
-    const std::vector<std::vector<double>>& getDistancesMatrix() const {
-        return distancesMatrix;
-    }
-
-    void setDistancesMatrix(const std::vector<std::vector<double>>& newMatrix) {
-        distancesMatrix = newMatrix;
-    }
-
-    // Getter and setter methods for timesMatrix
-    const std::vector<std::vector<double>>& getTimesMatrix() const {
-        return timesMatrix;
-    }
-
-    void setTimesMatrix(const std::vector<std::vector<double>>& newMatrix) {
-        timesMatrix = newMatrix;
-    }
-
-    // Getter and setter methods for nodesMatrix
-    const std::vector<NodeDataRow>& getNodesMatrix() const {
-        return nodesMatrix;
-    }
-
-    void setNodesMatrix(const std::vector<NodeDataRow>& newData) {
-        nodesMatrix = newData;
-    }
-
-    // Getter and setter methods for edgesMatrix
-    const std::vector<EdgeDataRow>& getEdgesMatrix() const {
-        return edgesMatrix;
-    }
-
-    void setEdgesMatrix(const std::vector<EdgeDataRow>& newData) {
-        edgesMatrix = newData;
-    }
-
-    // Additional methods to write matrices to CSV files
-    void writeDistancesMatrix(const std::string& filePath) const {
-        writeSquaredCSV(filePath, distancesMatrix);
-    }
-
-    void writeTimesMatrix(const std::string& filePath) const {
-        writeSquaredCSV(filePath, timesMatrix);
-    }
-
-    void writeNodesMatrix(const std::string& filePath) const {
-        writeNodesCSV(filePath, nodesMatrix);
-    }
-
-    void writeEdgesMatrix(const std::string& filePath) const {
-        writeEdgesCSV(filePath, edgesMatrix);
-    }
-
-    // Getter method for numberOfBuses
-    int getNumberOfBuses() const {
-        return numberOfBuses;
+// Function to find the children of every node that no route picks up yet: numSchools values for each node ID
+std::vector<int> computeUnservedLoads(const std::vector<Route>& routes, const ProblemInstance& problemInstance) {
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> unserved(problemInstance.getDistancesMatrix().size() * numSchools, 0);
+    for (int busStop : problemInstance.getBusStopIDs()) {
+        const int* demands = problemInstance.getNodeDemands(busStop);
+        if (demands != nullptr) {
+            addSchoolLoads(unserved.data() + static_cast<size_t>(busStop) * numSchools, demands, numSchools);
+        }
     }
-
-    // Setter method for numberOfBuses
-    void setNumberOfBuses(int numBuses) {
-        numberOfBuses = numBuses;
+    for (const Route& route : routes) {
+        for (size_t e = 0; e < route.pickupStops.size(); ++e) {
+            subtractSchoolLoads(unserved.data() + static_cast<size_t>(route.pickupStops[e]) * numSchools,
+                                getPickupLoads(route, static_cast<int>(e)), numSchools);
+        }
     }
+    return unserved;
+}
 
-    // Getter method for busesCapacity
-    const std::vector<int>& getBusesCapacity() const {
-        return busCapacities;
-    }
+// Function to take up to capacity children from the remaining children of a stop, school by school (remaining is updated).
+// It returns the number of children taken, their schools are in taken
+int takeChildren(int* remaining, int numSchools, int capacity, SchoolLoads& taken) {
+    taken.fill(0);
+    int total = 0;
+    for (int k = 0; k < numSchools && total < capacity; ++k) {
+        taken[k] = std::min(remaining[k], capacity - total);
+        remaining[k] -= taken[k];
+        total += taken[k];
+    }
+    return total;
+}
 
-    // Setter method for busesCapacity
-    void setBusesCapacity(const std::vector<int>& capacities) {
-        busCapacities = capacities;
+// Function to compute again the cached cost and load of a route (e.g. after it is built)
+void refreshRouteCache(Route& route, const DistanceMatrix& distanceMatrix) {
+    route.cost = 0.0;
+    for (size_t i = 0; i + 1 < route.visitedNodes.size(); ++i) {
+        route.cost += distanceMatrix.at(route.visitedNodes[i], route.visitedNodes[i + 1]);
     }
-    
-
-};
-
-// ----------------- Initialization -----------------
-
+    route.load = totalSchoolLoad(route.childrenToCluster.data(), route.numSchools);
+    route.times.valid = false;
+}
 
-// Given a node ID, find the sum of children to clusters
-int sumChildrenToClusters(const std::vector<NodeDataRow>& nodesMatrix, int nodeId) {
-    for (const auto& node : nodesMatrix) {
-        if (node.id1 == nodeId || node.id2 == nodeId || node.id3 == nodeId) {
-            return node.children_to_cluster_1 + 
-                   node.children_to_cluster_2 + 
-                   node.children_to_cluster_3 + 
-                   node.children_to_cluster_4;
-        }
+// Function to get the fitness of an individual from the cached costs of its routes
+double sumRouteCosts(const std::vector<Route>& routes) {
+    double totalCost = 0.0;
+    for (const Route& route : routes) {
+        totalCost += route.cost;
     }
-    // If the node is not found, you might want to handle it
-    // For example, return -1 or throw an exception
-    return -1; // Indicating the node was not found
+    return totalCost;
 }
 
-// Struct to represent a Route
-struct Route {
-    int busIndex;
-    std::vector<int> visitedNodes; // Stores visited nodes
-    
-    // New fields to store the number of children to each cluster
-    int childrenToCluster1;
-    int childrenToCluster2;
-    int childrenToCluster3;
-    int childrenToCluster4;
-
-    // Constructor to initialize the variables
-    Route(int index) 
-        : busIndex(index), 
-          childrenToCluster1(0),
-          childrenToCluster2(0),
-          childrenToCluster3(0),
-          childrenToCluster4(0) {}
-};
-
 // Print the route
 void printRoute(const Route& route) {
 
@@ -405,75 +212,89 @@ void printRoute(const Route& route) {
     for (int node : route.visitedNodes) {
         std::cout << node << " ";
     }
-    std::cout << "\nChildren to cluster 1: " << route.childrenToCluster1 << std::endl;
-    std::cout << "Children to cluster 2: " << route.childrenToCluster2 << std::endl;
-    std::cout << "Children to cluster 3: " << route.childrenToCluster3 << std::endl;
-    std::cout << "Children to cluster 4: " << route.childrenToCluster4 << std::endl;
+    std::cout << std::endl;
+    for (int k = 0; k < route.numSchools; ++k) {
+        std::cout << "Children to cluster " << k + 1 << ": " << route.childrenToCluster[k] << std::endl;
+    }
+    for (size_t e = 0; e < route.pickupStops.size(); ++e) {
+        std::cout << "Children taken at node " << route.pickupStops[e] << ":";
+        const int* loads = getPickupLoads(route, static_cast<int>(e));
+        for (int k = 0; k < route.numSchools; ++k) {
+            std::cout << " " << loads[k];
+        }
+        std::cout << std::endl;
+    }
 }
 
-// Function to count the total number of children taken up by a bus in a route
+// Function to count the total number of children taken up by a bus in a route (cached in the route)
 int countTotalChildrenToClusters(const Route& route) {
-    return route.childrenToCluster1 + route.childrenToCluster2 + route.childrenToCluster3 + route.childrenToCluster4;
+    return route.load;
 }
 
-// Function to find the integer ID of the node where type = "cluster"
-int findClusterID(const std::vector<NodeDataRow>& nodesMatrix, int x) {
-    int count = 0; // Counter to track how many "cluster" types have been found
-    int size = nodesMatrix.size();
-
-    for (int i = 0; i < size; ++i) {
-        if (nodesMatrix[i].type == "cluster") {
-            ++count;
-            if (count == x) {
-                return nodesMatrix[i].id1; // Return id1 of the x-th "cluster" type row
-            }
-        }
-    }
-
-    // If x is greater than the number of "cluster" types found, return -1 or handle as needed
-    return -1; // Or any suitable error code indicating x-th "cluster" type not found
+// Function to find the integer ID of the x-th node where type = "cluster"
+// If x is greater than the number of "cluster" types found, it returns -1
+int findClusterID(const ProblemInstance& problemInstance, int x) {
+    return problemInstance.getClusterID(x);
 }
 
 // Function to find all cluster IDs
-std::vector<int> findAllClusterIDs(const std::vector<NodeDataRow>& nodesMatrix) {
-    std::vector<int> clusterIDs;
+// (precomputed at load, in the order of the nodes matrix)
+const std::vector<int>& findAllClusterIDs(const ProblemInstance& problemInstance) {
+    return problemInstance.getClusterIDs();
+}
+
 
-    for (const auto& node : nodesMatrix) {
-        if (node.type == "cluster") {
-            clusterIDs.push_back(node.id1);
+// Function to build the route of a bus that picks up, at one bus stop, as many of its remaining children as fit in the bus
+// (school by school, remaining is updated): depot -> bus stop -> schools of the children taken. busIndex is 1-based
+Route buildSingleStopRoute(const ProblemInstance& problemInstance, int busIndex, int capacity, int busStop, int* remaining) {
+    const int numSchools = problemInstance.getNumberOfSchools();
+    Route route(busIndex, numSchools);
+    SchoolLoads taken;
+    takeChildren(remaining, numSchools, capacity, taken);
+
+    route.visitedNodes.push_back(problemInstance.getDepotID()); // Start from depot
+    route.visitedNodes.push_back(busStop); // Visit the bus stop itself
+    for (int k = 0; k < numSchools; ++k) {
+        int clusterID = findClusterID(problemInstance, k + 1);
+        if (taken[k] > 0 && clusterID != -1) {
+            route.visitedNodes.push_back(clusterID);
         }
     }
 
-    return clusterIDs;
+    addPickup(route, busStop, taken.data());
+    refreshRouteCache(route, problemInstance.getDistancesMatrix());
+    return route;
 }
 
+// Function to select the buses (0-based indexes) whose capacity covers a demand
+std::vector<int> findBusesCoveringDemand(const std::vector<int>& busIndexes, const std::vector<int>& busesCapacities, int demand) {
+    std::vector<int> covering;
+    for (int busIndex : busIndexes) {
+        if (busesCapacities[busIndex] >= demand) {
+            covering.push_back(busIndex);
+        }
+    }
+    return covering;
+}
 
 // Function to build routes ot the following kind: depot -> bus stop -> cluster(s)
-// Moreover, it returns unserved nodes (if the number of buses is not enough to serve all bus stops)
-std::pair<std::vector<Route>, std::vector<int>> buildRoutes(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities) {
+// A bus stop with more children than a bus is split among consecutive buses (at most maxSplitsPerStop).
+// The last allowed split needs a bus that takes all the children left, otherwise they are left to the repair.
+// Moreover, it returns unserved nodes (if the number of buses is not enough to serve all bus stops, also the
+// partially served ones: the children left are found with computeUnservedLoads)
+std::pair<std::vector<Route>, std::vector<int>> buildRoutes(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities,
+                                                            int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
     std::vector<Route> routes;
 
-    // Access nodes from the instance
-    const auto& nodes = problemInstance.getNodesMatrix();
-
-    // Find depot and all bus stops
-    int depotNodeIndex = -1;
-    std::vector<int> busStopNodeIndices;
+    // Find depot and all bus stops (precomputed at load)
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> busStopNodeIndices = problemInstance.getBusStopIDs();
     std::vector<std::vector<int>> clusters; // To store children counts for each cluster
 
     // Assuming nodesMatrix structure based on provided data
-    for (const auto& node : nodes) {
-        if (node.type == "deposito") {
-            depotNodeIndex = node.id1;
-        } else if (node.type == "fermata") {
-            busStopNodeIndices.push_back(node.id1);
-            std::vector<int> childrenCounts;
-            childrenCounts.push_back(node.children_to_cluster_1);
-            childrenCounts.push_back(node.children_to_cluster_2);
-            childrenCounts.push_back(node.children_to_cluster_3);
-            childrenCounts.push_back(node.children_to_cluster_4);
-            clusters.push_back(childrenCounts);
-        }
+    for (int busStopId : busStopNodeIndices) {
+        const int* demands = problemInstance.getNodeDemands(busStopId);
+        clusters.emplace_back(demands, demands + numSchools);
     }
 
     // If no bus stops found, return empty routes and unserved nodes
@@ -481,100 +302,26 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutes(const ProblemInstanc
         return {routes, busStopNodeIndices};
     }
 
-    int busIndex = 1; // Start bus index from 1
+    size_t busIndex = 1; // Start bus index from 1
     std::vector<int> unservedBusStops;
 
     for (int busStopIndex : busStopNodeIndices) {
-        int totalChildren = clusters[busStopIndex - 1][0] + clusters[busStopIndex - 1][1] + clusters[busStopIndex - 1][2] + clusters[busStopIndex - 1][3];
-        int currentCapacity = 0;
-        bool served = false;
-
-        // Assign buses to this bus stop until the capacity constraint is satisfied
-        while (currentCapacity < totalChildren && busIndex <= busesCapacities.size()) {
-            int remainingCapacity = busesCapacities[busIndex - 1] - currentCapacity;
-            Route route(busIndex);
-
-            // Add nodes needed for this bus stop
-            std::vector<int> visitedNodes;
-            visitedNodes.push_back(depotNodeIndex); // Start from depot
-            visitedNodes.push_back(busStopIndex); // Visit the bus stop itself
-
-            // Add clusters needed for this bus stop
-            for (size_t clusterIndex = 0; clusterIndex < clusters[busStopIndex - 1].size(); ++clusterIndex) {
-                if (clusters[busStopIndex - 1][clusterIndex] > 0) {
-                    // Find the node ID corresponding to the cluster index
-                    int clusterNodeId = -1;
-                    // Assuming nodesMatrix has node ID corresponding to cluster indices
-                    for (const auto& node : nodes) {
-                        if (node.id1 == clusterIndex + 1) { // Assuming cluster indices are 1-based
-                            clusterNodeId = node.id1;
-                            break;
-                        }
-                    }
-                    if (clusterNodeId != -1) {
-                        int realClusterNodeId = findClusterID(problemInstance.getNodesMatrix(), clusterNodeId);
-                        visitedNodes.push_back(realClusterNodeId);
-                    }
-                }
+        int* remaining = clusters[busStopIndex - 1].data();
+        int splits = 0;
+
+        // Assign buses to this bus stop until all its children are taken
+        while (totalSchoolLoad(remaining, numSchools) > 0 && busIndex <= busesCapacities.size() && splits < maxSplitsPerStop) {
+            // A part left by the last allowed split could not be placed by the repair: the children left go to it instead
+            if (splits == maxSplitsPerStop - 1 && busesCapacities[busIndex - 1] < totalSchoolLoad(remaining, numSchools)) {
+                break;
             }
-
-            route.visitedNodes = visitedNodes;
-
-            // Distribute children to clusters according to bus capacity
-            for (size_t clusterIndex = 0; clusterIndex < clusters[busStopIndex - 1].size(); ++clusterIndex) {
-                int childrenCount = clusters[busStopIndex - 1][clusterIndex];
-                if (childrenCount > 0) {
-                    if (childrenCount <= remainingCapacity) {
-                        // Entire cluster fits into this bus
-                        switch (clusterIndex) {
-                            case 0:
-                                route.childrenToCluster1 = childrenCount;
-                                break;
-                            case 1:
-                                route.childrenToCluster2 = childrenCount;
-                                break;
-                            case 2:
-                                route.childrenToCluster3 = childrenCount;
-                                break;
-                            case 3:
-                                route.childrenToCluster4 = childrenCount;
-                                break;
-                            default:
-                                break;
-                        }
-                        currentCapacity += childrenCount;
-                    } else {
-                        // Distribute as much as possible to this cluster
-                        switch (clusterIndex) {
-                            case 0:
-                                route.childrenToCluster1 = remainingCapacity;
-                                break;
-                            case 1:
-                                route.childrenToCluster2 = remainingCapacity;
-                                break;
-                            case 2:
-                                route.childrenToCluster3 = remainingCapacity;
-                                break;
-                            case 3:
-                                route.childrenToCluster4 = remainingCapacity;
-                                break;
-                            default:
-                                break;
-                        }
-                        currentCapacity += remainingCapacity;
-                        // Remaining children go to the next bus
-                        clusters[busStopIndex - 1][clusterIndex] -= remainingCapacity;
-                    }
-                }
-            }
-
-            routes.push_back(route);
+            routes.push_back(buildSingleStopRoute(problemInstance, busIndex, busesCapacities[busIndex - 1], busStopIndex, remaining));
             busIndex++;
-            served = true;
+            splits++;
         }
 
         // Check if the bus stop was served
-        if (!served) {
+        if (totalSchoolLoad(remaining, numSchools) > 0) {
             unservedBusStops.push_back(busStopIndex);
         }
     }
@@ -584,21 +331,16 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutes(const ProblemInstanc
 }
 
 // Same of the buildRoutes function, but with picking the buses randomly 
-std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBuses(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities) {
+std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBuses(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities,
+                                                                       int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
     std::vector<Route> routes;
-    const auto& nodes = problemInstance.getNodesMatrix();
-
-    int depotNodeIndex = -1;
-    std::vector<int> busStopNodeIndices;
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> busStopNodeIndices = problemInstance.getBusStopIDs();
     std::vector<std::vector<int>> clusters;
 
-    for (const auto& node : nodes) {
-        if (node.type == "deposito") {
-            depotNodeIndex = node.id1;
-        } else if (node.type == "fermata") {
-            busStopNodeIndices.push_back(node.id1);
-            clusters.push_back({node.children_to_cluster_1, node.children_to_cluster_2, node.children_to_cluster_3, node.children_to_cluster_4});
-        }
+    for (int busStopId : busStopNodeIndices) {
+        const int* demands = problemInstance.getNodeDemands(busStopId);
+        clusters.emplace_back(demands, demands + numSchools);
     }
 
     if (busStopNodeIndices.empty()) {
@@ -610,60 +352,29 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBuses(const Pro
     std::iota(busIndexes.begin(), busIndexes.end(), 0); // Fill with 0, 1, 2, ..., n-1
 
     std::vector<int> unservedBusStops;
-    std::random_device rd; // Obtain a random number from hardware
-    std::mt19937 gen(rd()); // Seed the generator
+    std::mt19937& gen = randomEngine(); // Random engine of this thread
 
     for (int busStopIndex : busStopNodeIndices) {
-        int totalChildren = clusters[busStopIndex - 1][0] + clusters[busStopIndex - 1][1] + clusters[busStopIndex - 1][2] + clusters[busStopIndex - 1][3];
-        int currentCapacity = 0;
-        bool served = false;
-
-        // Assign buses to this bus stop until the capacity constraint is satisfied
-        while (currentCapacity < totalChildren && !busIndexes.empty()) {
-            std::uniform_int_distribution<> dis(0, busIndexes.size() - 1);
-            int busIndex = busIndexes[dis(gen)];
-            busIndexes.erase(std::remove(busIndexes.begin(), busIndexes.end(), busIndex), busIndexes.end());
-            int remainingCapacity = busesCapacities[busIndex] - currentCapacity;
-            Route route(busIndex + 1); // Bus index should be 1-based
-
-            std::vector<int> visitedNodes;
-            visitedNodes.push_back(depotNodeIndex); // Start from depot
-            visitedNodes.push_back(busStopIndex); // Visit the bus stop itself
-
-            for (size_t clusterIndex = 0; clusterIndex < clusters[busStopIndex - 1].size(); ++clusterIndex) {
-                if (clusters[busStopIndex - 1][clusterIndex] > 0) {
-                    int clusterNodeId = clusterIndex + 1;
-                    int realClusterNodeId = findClusterID(problemInstance.getNodesMatrix(), clusterNodeId);
-                    visitedNodes.push_back(realClusterNodeId);
-
-                    int childrenCount = clusters[busStopIndex - 1][clusterIndex];
-                    if (childrenCount <= remainingCapacity) {
-                        currentCapacity += childrenCount;
-                        switch (clusterIndex) {
-                            case 0: route.childrenToCluster1 = childrenCount; break;
-                            case 1: route.childrenToCluster2 = childrenCount; break;
-                            case 2: route.childrenToCluster3 = childrenCount; break;
-                            case 3: route.childrenToCluster4 = childrenCount; break;
-                        }
-                    } else {
-                        currentCapacity += remainingCapacity;
-                        switch (clusterIndex) {
-                            case 0: route.childrenToCluster1 = remainingCapacity; break;
-                            case 1: route.childrenToCluster2 = remainingCapacity; break;
-                            case 2: route.childrenToCluster3 = remainingCapacity; break;
-                            case 3: route.childrenToCluster4 = remainingCapacity; break;
-                        }
-                        clusters[busStopIndex - 1][clusterIndex] -= remainingCapacity;
-                    }
-                }
+        int* remaining = clusters[busStopIndex - 1].data();
+        int splits = 0;
+
+        // Assign buses to this bus stop until all its children are taken
+        while (totalSchoolLoad(remaining, numSchools) > 0 && !busIndexes.empty() && splits < maxSplitsPerStop) {
+            // The last allowed split is drawn among the buses that take all the children left (a part left by a smaller bus
+            // could not be placed by the repair); if there is none, the children left go to the repair
+            std::vector<int> candidates = (splits == maxSplitsPerStop - 1)
+                ? findBusesCoveringDemand(busIndexes, busesCapacities, totalSchoolLoad(remaining, numSchools)) : busIndexes;
+            if (candidates.empty()) {
+                break;
             }
-
-            route.visitedNodes = visitedNodes;
-            routes.push_back(route);
-            served = true;
+            std::uniform_int_distribution<> dis(0, candidates.size() - 1);
+            int busIndex = candidates[dis(gen)];
+            busIndexes.erase(std::remove(busIndexes.begin(), busIndexes.end(), busIndex), busIndexes.end());
+            routes.push_back(buildSingleStopRoute(problemInstance, busIndex + 1, busesCapacities[busIndex], busStopIndex, remaining)); // Bus index should be 1-based
+            splits++;
         }
 
-        if (!served) {
+        if (totalSchoolLoad(remaining, numSchools) > 0) {
             unservedBusStops.push_back(busStopIndex);
         }
     }
@@ -671,22 +382,18 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBuses(const Pro
     return {routes, unservedBusStops};
 }
 
-// Same of the buildRoutes function, but with picking the buses randomly and picking the nodes randomly
-std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBusesAndNodes(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities) {
+// Same of the buildRoutes function, but with picking the buses randomly and picking the nodes randomly.
+// Every bus is used by one route at most, so a bus never takes more children than its capacity
+std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBusesAndNodes(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities,
+                                                                               int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
     std::vector<Route> routes;
-    const auto& nodes = problemInstance.getNodesMatrix();
-
-    int depotNodeIndex = -1;
-    std::vector<int> busStopNodeIndices;
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> busStopNodeIndices = problemInstance.getBusStopIDs();
     std::vector<std::vector<int>> clusters;
 
-    for (const auto& node : nodes) {
-        if (node.type == "deposito") {
-            depotNodeIndex = node.id1;
-        } else if (node.type == "fermata") {
-            busStopNodeIndices.push_back(node.id1);
-            clusters.push_back({node.children_to_cluster_1, node.children_to_cluster_2, node.children_to_cluster_3, node.children_to_cluster_4});
-        }
+    for (int busStopId : busStopNodeIndices) {
+        const int* demands = problemInstance.getNodeDemands(busStopId);
+        clusters.emplace_back(demands, demands + numSchools);
     }
 
     if (busStopNodeIndices.empty()) {
@@ -694,58 +401,38 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBusesAndNodes(c
     }
 
     // Shuffle bus stop indices
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937& gen = randomEngine();
     std::shuffle(busStopNodeIndices.begin(), busStopNodeIndices.end(), gen);
 
     std::vector<int> unservedBusStops;
-    std::vector<int> remainingBusIndexes(busesCapacities.size());
-    std::iota(remainingBusIndexes.begin(), remainingBusIndexes.end(), 0); // Fill with 0, 1, 2, ..., n-1
+    std::vector<int> remainingBusIndexes;
+    for (size_t busIndex = 0; busIndex < busesCapacities.size(); ++busIndex) {
+        if (busesCapacities[busIndex] > 0) {
+            remainingBusIndexes.push_back(static_cast<int>(busIndex));
+        }
+    }
 
     for (int busStopIndex : busStopNodeIndices) {
-        int totalChildren = clusters[busStopIndex - 1][0] + clusters[busStopIndex - 1][1] + clusters[busStopIndex - 1][2] + clusters[busStopIndex - 1][3];
-        int childrenServed = 0;
-
-        while (childrenServed < totalChildren && !remainingBusIndexes.empty()) {
-            std::uniform_int_distribution<> dis(0, remainingBusIndexes.size() - 1);
-            int busIndex = remainingBusIndexes[dis(gen)];
-            int remainingCapacity = busesCapacities[busIndex] - childrenServed;
-            Route route(busIndex + 1); // Bus index should be 1-based
-
-            std::vector<int> visitedNodes;
-            visitedNodes.push_back(depotNodeIndex); // Start from depot
-            visitedNodes.push_back(busStopIndex); // Visit the bus stop itself
-
-            for (size_t clusterIndex = 0; clusterIndex < clusters[busStopIndex - 1].size(); ++clusterIndex) {
-                if (clusters[busStopIndex - 1][clusterIndex] > 0) {
-                    int clusterNodeId = clusterIndex + 1;
-                    int realClusterNodeId = findClusterID(problemInstance.getNodesMatrix(), clusterNodeId);
-                    visitedNodes.push_back(realClusterNodeId);
-
-                    int childrenCount = std::min(clusters[busStopIndex - 1][clusterIndex], remainingCapacity);
-                    switch (clusterIndex) {
-                        case 0: route.childrenToCluster1 += childrenCount; break;
-                        case 1: route.childrenToCluster2 += childrenCount; break;
-                        case 2: route.childrenToCluster3 += childrenCount; break;
-                        case 3: route.childrenToCluster4 += childrenCount; break;
-                    }
-
-                    childrenServed += childrenCount;
-                    clusters[busStopIndex - 1][clusterIndex] -= childrenCount;
-                }
-            }
-
-            route.visitedNodes = visitedNodes;
-            routes.push_back(route);
-
-            // Remove bus index if capacity is fully utilized
-            if (childrenServed >= totalChildren) {
-                remainingBusIndexes.erase(std::remove(remainingBusIndexes.begin(), remainingBusIndexes.end(), busIndex), remainingBusIndexes.end());
+        int* remaining = clusters[busStopIndex - 1].data();
+        int splits = 0;
+
+        while (totalSchoolLoad(remaining, numSchools) > 0 && !remainingBusIndexes.empty() && splits < maxSplitsPerStop) {
+            // The last allowed split is drawn among the buses that take all the children left (a part left by a smaller bus
+            // could not be placed by the repair); if there is none, the children left go to the repair
+            std::vector<int> candidates = (splits == maxSplitsPerStop - 1)
+                ? findBusesCoveringDemand(remainingBusIndexes, busesCapacities, totalSchoolLoad(remaining, numSchools)) : remainingBusIndexes;
+            if (candidates.empty()) {
+                break;
             }
+            std::uniform_int_distribution<> dis(0, candidates.size() - 1);
+            int busIndex = candidates[dis(gen)];
+            remainingBusIndexes.erase(std::remove(remainingBusIndexes.begin(), remainingBusIndexes.end(), busIndex), remainingBusIndexes.end());
+            routes.push_back(buildSingleStopRoute(problemInstance, busIndex + 1, busesCapacities[busIndex], busStopIndex, remaining)); // Bus index should be 1-based
+            splits++;
         }
 
-        // If still children left and no more buses, mark bus stop as unserved
-        if (childrenServed < totalChildren) {
+        // If still children left (no more buses, or none for the last split), mark bus stop as unserved
+        if (totalSchoolLoad(remaining, numSchools) > 0) {
             unservedBusStops.push_back(busStopIndex);
         }
     }
@@ -754,40 +441,188 @@ std::pair<std::vector<Route>, std::vector<int>> buildRoutesRandomBusesAndNodes(c
 }
 
 // Function to check if adding a node's children to a route is within bus capacity
-bool canAddNodeToRoute(const std::vector<NodeDataRow>& nodesMatrix, const Route& route, int nodeId, const std::vector<int>& busesCapacities) {
+bool canAddNodeToRoute(const ProblemInstance& problemInstance, const Route& route, int nodeId, const std::vector<int>& busesCapacities) {
     int busCapacity = busesCapacities[route.busIndex - 1]; // Assuming busIndex is 1-based
 
-    for (const auto& node : nodesMatrix) {
-        if (node.id1 == nodeId || node.id2 == nodeId || node.id3 == nodeId) {
-            int routeTotalChildren = route.childrenToCluster1 + route.childrenToCluster2 + route.childrenToCluster3 + route.childrenToCluster4; 
-            int nodeTotalChildren = node.children_to_cluster_1 + node.children_to_cluster_2 + node.children_to_cluster_3 + node.children_to_cluster_4;
+    int nodeTotalChildren = problemInstance.getNodeTotalDemand(nodeId);
+    if (nodeTotalChildren == -1) {
+        // If the node is not found, return false
+        return false;
+    }
+    int routeTotalChildren = countTotalChildrenToClusters(route);
+
+    // Print info
+    //std::cout << "\nNode selected " << nodeId << std::endl;
+    //std::cout << "Bus selected " << route.busIndex << std::endl;
+    //std::cout << "Bus capacity: " << busCapacity << std::endl;
+    //std::cout << "Route total children: " << routeTotalChildren << std::endl;
+    //std::cout << "Node total children: " << nodeTotalChildren << std::endl;
+    //std::cout << std::endl;
+
+    return routeTotalChildren + nodeTotalChildren <= busCapacity;
+}
+
+// Index of the routes of a solution by residual capacity (capacity of the bus minus the load of the route).
+// The routes are kept sorted by decreasing residual capacity in order, so the routes where a demand fits
+// are always a prefix of it, and the weights of the routes are kept in a Fenwick tree over the same order.
+// A fitting route is drawn uniformly in O(1) or with a probability proportional to its weight in O(log R),
+// and a draw returns -1 at once when no route fits.
+class ResidualCapacityIndex {
+public:
+    ResidualCapacityIndex(const std::vector<Route>& routes, const std::vector<int>& busesCapacities, const std::vector<double>& weights)
+        : residuals(routes.size()), position(routes.size()), order(routes.size()), routeWeights(weights), tree(routes.size() + 1, 0.0) {
+        if (weights.size() != routes.size()) {
+            throw std::runtime_error("One weight per route is needed by the residual capacity index");
+        }
+        int maxResidual = 0;
+        for (size_t r = 0; r < routes.size(); ++r) {
+            residuals[r] = std::max(0, busesCapacities[routes[r].busIndex - 1] - routes[r].load);
+            maxResidual = std::max(maxResidual, residuals[r]);
+        }
+
+        // Counting sort by decreasing residual capacity: fitting[c] is the number of routes with residual >= c
+        fitting.assign(maxResidual + 2, 0);
+        for (int residual : residuals) {
+            fitting[residual]++;
+        }
+        for (int c = maxResidual - 1; c >= 0; --c) {
+            fitting[c] += fitting[c + 1];
+        }
+        std::vector<int> next(fitting.begin() + 1, fitting.end()); // First free position of each block
+        for (size_t r = 0; r < routes.size(); ++r) {
+            int pos = next[residuals[r]]++;
+            order[pos] = static_cast<int>(r);
+            position[r] = pos;
+            addToTree(pos, routeWeights[r]);
+        }
+    }
+
+    // Number of routes where a demand fits
+    int countFitting(int demand) const {
+        if (demand < 0) {
+            return 0;
+        }
+        return demand < static_cast<int>(fitting.size()) ? fitting[demand] : 0;
+    }
+
+    // Method to draw uniformly a route where a demand fits, u is a random value in [0, 1). It returns -1 if no route fits
+    int drawUniform(int demand, double u) const {
+        int count = countFitting(demand);
+        if (count == 0) {
+            return -1;
+        }
+        return order[std::min(count - 1, static_cast<int>(u * count))];
+    }
+
+    // Method to draw a route where a demand fits with a probability proportional to its weight. It returns -1 if no route fits
+    int drawWeighted(int demand, double u) const {
+        int count = countFitting(demand);
+        if (count == 0) {
+            return -1;
+        }
+        double target = u * prefixWeight(count);
+
+        // Descent of the Fenwick tree: the first position whose prefix weight exceeds target
+        int pos = 0;
+        for (int step = highestPowerOfTwo(static_cast<int>(order.size())); step > 0; step >>= 1) {
+            if (pos + step <= count && tree[pos + step] <= target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return order[std::min(pos, count - 1)];
+    }
+
+    // Method to update the load of a route (e.g. after a node is added to it)
+    void updateRoute(int route, const Route& updated, const std::vector<int>& busesCapacities) {
+        int newResidual = std::max(0, busesCapacities[updated.busIndex - 1] - updated.load);
+        // The block of each residual value is crossed with one swap, from the current value to the new one
+        while (residuals[route] > newResidual) {
+            int v = residuals[route];
+            swapPositions(position[route], fitting[v] - 1);
+            fitting[v]--;
+            residuals[route] = v - 1;
+        }
+        while (residuals[route] < newResidual) {
+            int v = residuals[route] + 1;
+            if (v + 1 >= static_cast<int>(fitting.size())) {
+                fitting.resize(v + 2, 0);
+            }
+            swapPositions(position[route], fitting[v]);
+            fitting[v]++;
+            residuals[route] = v;
+        }
+    }
+
+    // Method to change the weight of a route
+    void setWeight(int route, double weight) {
+        addToTree(position[route], weight - routeWeights[route]);
+        routeWeights[route] = weight;
+    }
+
+    int getResidual(int route) const { return residuals[route]; }
 
-            // Print info
-            //std::cout << "\nNode selected " << nodeId << std::endl;
-            //std::cout << "Bus selected " << route.busIndex << std::endl;
-            //std::cout << "Bus capacity: " << busCapacity << std::endl;
-            //std::cout << "Route total children: " << routeTotalChildren << std::endl;
-            //std::cout << "Node total children: " << nodeTotalChildren << std::endl;
-            //std::cout << std::endl;
+private:
+    void swapPositions(int a, int b) {
+        if (a == b) {
+            return;
+        }
+        int routeA = order[a];
+        int routeB = order[b];
+        double difference = routeWeights[routeB] - routeWeights[routeA];
+        addToTree(a, difference);
+        addToTree(b, -difference);
+        std::swap(order[a], order[b]);
+        position[routeA] = b;
+        position[routeB] = a;
+    }
+
+    void addToTree(int pos, double value) {
+        for (int i = pos + 1; i < static_cast<int>(tree.size()); i += i & (-i)) {
+            tree[i] += value;
+        }
+    }
 
-            return routeTotalChildren + nodeTotalChildren <= busCapacity;
+    // Sum of the weights at the positions [0, count)
+    double prefixWeight(int count) const {
+        double sum = 0.0;
+        for (int i = count; i > 0; i -= i & (-i)) {
+            sum += tree[i];
         }
+        return sum;
     }
 
-    // If the node is not found, return false
-    return false;
+    static int highestPowerOfTwo(int value) {
+        int power = 1;
+        while (power * 2 <= value) {
+            power *= 2;
+        }
+        return value > 0 ? power : 0;
+    }
+
+    std::vector<int> residuals; // Residual capacity of each route
+    std::vector<int> position; // Position of each route in order
+    std::vector<int> order; // Routes sorted by decreasing residual capacity
+    std::vector<int> fitting; // fitting[c]: number of routes with residual capacity >= c
+    std::vector<double> routeWeights; // Weight of each route
+    std::vector<double> tree; // Fenwick tree of the weights over the positions of order (1-based)
+};
+
+// Random value in [0, 1) from the random engine of this thread, for the draws of ResidualCapacityIndex
+double randomUnit() {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(randomEngine());
 }
 
 
 
 // Function to calculate the total distance based on visited nodes and distance matrix
-double calculateTotalDistance(const std::vector<int>& visitedNodes, const std::vector<std::vector<double>>& distanceMatrix) {
+double calculateTotalDistance(const std::vector<int>& visitedNodes, const DistanceMatrix& distanceMatrix) {
     double totalDistance = 0.0;
 
     for (size_t i = 0; i < visitedNodes.size() - 1; ++i) {
         int fromNode = visitedNodes[i];
         int toNode = visitedNodes[i + 1];
-        totalDistance += distanceMatrix[fromNode+1][toNode+1]; // Assuming distanceMatrix is 1-based
+        totalDistance += distanceMatrix.at(fromNode, toNode);
     }
 
     return totalDistance;
@@ -808,8 +643,391 @@ void generatePermutations(const std::vector<int>& elements, std::vector<std::vec
     } while (std::next_permutation(temp.begin(), temp.end()));
 }
 
-// Function to find the route with the smallest total distance
-void findOptimalRoute(Route& route, const std::vector<int>& clusterIDs, const std::vector<std::vector<double>>& distanceMatrix) {
+// Cache of the best ordering found by findOptimalRoute for a set of nodes, shared by all the routes built on one distance matrix.
+// The key is the XOR of a random 64 bit (Zobrist) key of each node, so it does not depend on the order of the nodes;
+// an entry also keeps the sorted nodes, so that a collision of the keys is never taken as a hit.
+// The map is split in shards with one mutex each, so the cache can be used by several threads.
+class RouteCostCache {
+public:
+    explicit RouteCostCache(size_t numNodes, size_t maxEntries = 1 << 20)
+        : nodeKeys(numNodes), maxEntries(maxEntries), entries(0), hits(0), misses(0), collisions(0) {
+        std::mt19937_64 gen(0x5B5F5EEDULL);
+        for (uint64_t& key : nodeKeys) {
+            key = gen();
+        }
+    }
+
+    RouteCostCache(const RouteCostCache&) = delete;
+    RouteCostCache& operator=(const RouteCostCache&) = delete;
+
+    // Method to compute the key of the set of nodes of a route
+    uint64_t hashNodes(const std::vector<int>& nodes) const {
+        uint64_t key = 0;
+        for (int node : nodes) {
+            key ^= nodeKeys.at(node);
+        }
+        return key;
+    }
+
+    // Method to look for the nodes of a route: on a hit the route takes the cached ordering and cost
+    bool lookup(Route& route) {
+        uint64_t key = hashNodes(route.visitedNodes);
+        std::vector<int> sortedNodes = sortedCopy(route.visitedNodes);
+        Shard& shard = shardOf(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.map.find(key);
+            if (it != shard.map.end()) {
+                if (it->second.sortedNodes == sortedNodes && it->second.orderedNodes[0] == route.visitedNodes[0]) {
+                    route.visitedNodes = it->second.orderedNodes;
+                    route.cost = it->second.cost;
+                    route.times.valid = false;
+                    hits++;
+                    return true;
+                }
+                collisions++;
+            }
+        }
+        misses++;
+        return false;
+    }
+
+    // Method to store the ordering and the cost of a route (nothing is stored when the cache is full or the key is taken)
+    void store(const Route& route) {
+        if (entries.load() >= maxEntries) {
+            return;
+        }
+        uint64_t key = hashNodes(route.visitedNodes);
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.map.emplace(key, Entry{sortedCopy(route.visitedNodes), route.visitedNodes, route.cost}).second) {
+            entries++;
+        }
+    }
+
+    size_t size() const { return entries.load(); }
+
+    // Approximate memory used by the entries (the buckets of the maps are not counted)
+    size_t bytes() {
+        size_t total = nodeKeys.size() * sizeof(uint64_t);
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& [key, entry] : shard.map) {
+                total += sizeof(key) + sizeof(entry) + 2 * sizeof(void*)
+                       + (entry.sortedNodes.capacity() + entry.orderedNodes.capacity()) * sizeof(int);
+            }
+        }
+        return total;
+    }
+
+    // Method to print the hit rate and the memory use of the cache
+    void printStatistics() {
+        size_t lookups = hits.load() + misses.load();
+        std::cout << "Route cache: " << size() << " entries, " << bytes() / 1024.0 << " KiB, "
+                  << hits.load() << " hits out of " << lookups << " lookups ("
+                  << (lookups > 0 ? 100.0 * hits.load() / lookups : 0.0) << "%), "
+                  << collisions.load() << " key collisions" << std::endl;
+    }
+
+private:
+    struct Entry {
+        std::vector<int> sortedNodes; // Set of the nodes, to tell apart two sets with the same key
+        std::vector<int> orderedNodes; // Best ordering found
+        double cost;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Entry> map;
+    };
+
+    static constexpr size_t NUM_SHARDS = 16;
+
+    Shard& shardOf(uint64_t key) { return shards[key % NUM_SHARDS]; }
+
+    static std::vector<int> sortedCopy(const std::vector<int>& nodes) {
+        std::vector<int> sorted = nodes;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
+    }
+
+    std::vector<uint64_t> nodeKeys; // Zobrist key of each node
+    size_t maxEntries;
+    std::array<Shard, NUM_SHARDS> shards;
+    std::atomic<size_t> entries;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> collisions;
+};
+
+// Held-Karp table of one group of nodes (the bus stops or the schools of a route): best open path that enters the group
+// at node k with the cost entryCost[k] and visits every node of the group, over the states (subset of the group, last node).
+// The tables are kept by the caller and reused, so a solve does not allocate once they are large enough.
+struct HeldKarpTable {
+    std::vector<double> cost; // cost[mask * n + k]: best path over the nodes in mask that ends at node k
+    std::vector<uint8_t> parent; // parent[mask * n + k]: node before k in that path (n for the entry)
+    int n = 0;
+
+    // Method to fill the table for the given nodes
+    void solve(const std::vector<int>& nodes, const std::vector<double>& entryCost, const DistanceMatrix& distanceMatrix) {
+        n = static_cast<int>(nodes.size());
+        size_t numStates = (size_t(1) << n) * n;
+        cost.assign(numStates, std::numeric_limits<double>::infinity());
+        parent.resize(numStates);
+
+        for (int k = 0; k < n; ++k) {
+            cost[(size_t(1) << k) * n + k] = entryCost[k];
+            parent[(size_t(1) << k) * n + k] = static_cast<uint8_t>(n);
+        }
+        for (size_t mask = 1; mask < (size_t(1) << n); ++mask) {
+            for (int last = 0; last < n; ++last) {
+                double current = cost[mask * n + last];
+                if (!(mask & (size_t(1) << last)) || current == std::numeric_limits<double>::infinity()) {
+                    continue;
+                }
+                for (int next = 0; next < n; ++next) {
+                    if (mask & (size_t(1) << next)) {
+                        continue;
+                    }
+                    size_t state = (mask | (size_t(1) << next)) * n + next;
+                    double candidate = current + distanceMatrix.at(nodes[last], nodes[next]);
+                    if (candidate < cost[state]) {
+                        cost[state] = candidate;
+                        parent[state] = static_cast<uint8_t>(last);
+                    }
+                }
+            }
+        }
+    }
+
+    // Cost of the best path over all the nodes that ends at node k
+    double fullCost(int k) const { return cost[((size_t(1) << n) - 1) * n + k]; }
+
+    // Method to write the best path over all the nodes that ends at node k (in visiting order)
+    void appendPath(const std::vector<int>& nodes, int k, std::vector<int>& path) const {
+        std::vector<int> reversed;
+        size_t mask = (size_t(1) << n) - 1;
+        while (k < n) {
+            reversed.push_back(nodes[k]);
+            int previous = parent[mask * n + k];
+            mask &= ~(size_t(1) << k);
+            k = previous;
+        }
+        path.insert(path.end(), reversed.rbegin(), reversed.rend());
+    }
+};
+
+// Largest group of bus stops (or schools) sequenced exactly by Held-Karp: 2^18 * 18 states take about 40 MB
+const int HELD_KARP_MAX_GROUP = 18;
+
+// Function to find the shortest route depot -> all the bus stops -> all the schools with the Held-Karp dynamic programming.
+// The stops are solved first (entering from the depot); the schools enter from the best stop path ending at each stop,
+// and the argmin of that entry gives the last stop. It is exact, in O(2^s s^2 + 2^c c^2 + s c) time for s stops and c schools.
+std::vector<int> sequenceRouteHeldKarp(int depot, const std::vector<int>& busStops, const std::vector<int>& clusters, const DistanceMatrix& distanceMatrix) {
+    thread_local HeldKarpTable stopTable;
+    thread_local HeldKarpTable clusterTable;
+    std::vector<int> sequence = { depot };
+
+    int numStops = static_cast<int>(busStops.size());
+    int numClusters = static_cast<int>(clusters.size());
+
+    if (numStops > 0) {
+        std::vector<double> entryCost(numStops);
+        for (int k = 0; k < numStops; ++k) {
+            entryCost[k] = distanceMatrix.at(depot, busStops[k]);
+        }
+        stopTable.solve(busStops, entryCost, distanceMatrix);
+    }
+
+    // Entry of the schools: the best stop path followed by the arc to the first school
+    std::vector<double> clusterEntryCost(numClusters);
+    std::vector<int> lastStopBefore(numClusters, -1);
+    for (int c = 0; c < numClusters; ++c) {
+        if (numStops == 0) {
+            clusterEntryCost[c] = distanceMatrix.at(depot, clusters[c]);
+            continue;
+        }
+        clusterEntryCost[c] = std::numeric_limits<double>::infinity();
+        for (int k = 0; k < numStops; ++k) {
+            double candidate = stopTable.fullCost(k) + distanceMatrix.at(busStops[k], clusters[c]);
+            if (candidate < clusterEntryCost[c]) {
+                clusterEntryCost[c] = candidate;
+                lastStopBefore[c] = k;
+            }
+        }
+    }
+
+    if (numClusters == 0) {
+        if (numStops > 0) {
+            int bestLast = 0;
+            for (int k = 1; k < numStops; ++k) {
+                if (stopTable.fullCost(k) < stopTable.fullCost(bestLast)) {
+                    bestLast = k;
+                }
+            }
+            stopTable.appendPath(busStops, bestLast, sequence);
+        }
+        return sequence;
+    }
+
+    clusterTable.solve(clusters, clusterEntryCost, distanceMatrix);
+    int bestLastCluster = 0;
+    for (int c = 1; c < numClusters; ++c) {
+        if (clusterTable.fullCost(c) < clusterTable.fullCost(bestLastCluster)) {
+            bestLastCluster = c;
+        }
+    }
+
+    std::vector<int> clusterPath;
+    clusterTable.appendPath(clusters, bestLastCluster, clusterPath);
+    if (numStops > 0) {
+        int firstCluster = static_cast<int>(std::find(clusters.begin(), clusters.end(), clusterPath[0]) - clusters.begin());
+        stopTable.appendPath(busStops, lastStopBefore[firstCluster], sequence);
+    }
+    sequence.insert(sequence.end(), clusterPath.begin(), clusterPath.end());
+    return sequence;
+}
+
+// Function to improve the order of the nodes in sequence[first, last) by moving one node or reversing one segment,
+// as long as the total distance of the whole sequence decreases
+void improveSequenceBlock(std::vector<int>& sequence, size_t first, size_t last, const DistanceMatrix& distanceMatrix) {
+    double bestDistance = calculateTotalDistance(sequence, distanceMatrix);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (size_t i = first; i + 1 < last; ++i) {
+            for (size_t j = i + 1; j < last; ++j) {
+                // Reversal of [i, j] (the matrix can be asymmetric, so the whole route is measured again)
+                std::reverse(sequence.begin() + i, sequence.begin() + j + 1);
+                double distance = calculateTotalDistance(sequence, distanceMatrix);
+                if (distance < bestDistance - 1e-9) {
+                    bestDistance = distance;
+                    improved = true;
+                } else {
+                    std::reverse(sequence.begin() + i, sequence.begin() + j + 1);
+                }
+
+                // Move of the node at i to position j
+                std::rotate(sequence.begin() + i, sequence.begin() + i + 1, sequence.begin() + j + 1);
+                distance = calculateTotalDistance(sequence, distanceMatrix);
+                if (distance < bestDistance - 1e-9) {
+                    bestDistance = distance;
+                    improved = true;
+                } else {
+                    std::rotate(sequence.begin() + i, sequence.begin() + j, sequence.begin() + j + 1);
+                }
+            }
+        }
+    }
+}
+
+// Function to sequence a route too large for Held-Karp: nearest neighbour from the depot over the bus stops,
+// then over the schools, improved by moves and reversals inside the stops and inside the schools
+std::vector<int> sequenceRouteHeuristic(int depot, const std::vector<int>& busStops, const std::vector<int>& clusters, const DistanceMatrix& distanceMatrix) {
+    std::vector<int> sequence = { depot };
+    for (const std::vector<int>* group : { &busStops, &clusters }) {
+        std::vector<int> remaining = *group;
+        while (!remaining.empty()) {
+            auto nearest = std::min_element(remaining.begin(), remaining.end(), [&](int a, int b) {
+                return distanceMatrix.at(sequence.back(), a) < distanceMatrix.at(sequence.back(), b);
+            });
+            sequence.push_back(*nearest);
+            remaining.erase(nearest);
+        }
+    }
+
+    improveSequenceBlock(sequence, 1, 1 + busStops.size(), distanceMatrix);
+    improveSequenceBlock(sequence, 1 + busStops.size(), sequence.size(), distanceMatrix);
+    return sequence;
+}
+
+// Branch and bound over the orderings of a route, enumerated in place: the nodes are kept in one array and the node
+// at each depth is chosen by swapping it into place, so the memory is O(route length). The cost of the prefix is
+// carried along, and a prefix is pruned when its cost plus a lower bound of the rest (the cheapest arc entering each
+// node still to visit) is not below the best route found. The first incumbent is the heuristic route.
+class BranchAndBoundSequencer {
+public:
+    BranchAndBoundSequencer(int depot, const std::vector<int>& busStops, const std::vector<int>& clusters, const DistanceMatrix& distanceMatrix)
+        : distanceMatrix(distanceMatrix), numStops(busStops.size()), order({ depot }), minEntry(1 + busStops.size() + clusters.size(), 0.0) {
+        order.insert(order.end(), busStops.begin(), busStops.end());
+        order.insert(order.end(), clusters.begin(), clusters.end());
+
+        // Cheapest arc entering each node from a node that can precede it (the depot or a stop before a stop,
+        // the last stop or another school before a school)
+        for (size_t v = 1; v < order.size(); ++v) {
+            bool isStop = v <= numStops;
+            double cheapest = std::numeric_limits<double>::infinity();
+            for (size_t u = 0; u < order.size(); ++u) {
+                bool canPrecede = isStop ? (u <= numStops) : (numStops == 0 || u >= 1);
+                if (u != v && canPrecede) {
+                    cheapest = std::min(cheapest, distanceMatrix.at(order[u], order[v]));
+                }
+            }
+            minEntry[v] = cheapest;
+        }
+
+        best = sequenceRouteHeuristic(depot, busStops, clusters, distanceMatrix);
+        bestDistance = calculateTotalDistance(best, distanceMatrix);
+    }
+
+    // Method to run the search and return the best route
+    const std::vector<int>& solve() {
+        double remainingBound = 0.0;
+        for (size_t v = 1; v < order.size(); ++v) {
+            remainingBound += minEntry[v];
+        }
+        branch(1, 0.0, remainingBound);
+        return best;
+    }
+
+private:
+    void branch(size_t depth, double prefixDistance, double remainingBound) {
+        if (depth == order.size()) {
+            if (prefixDistance < bestDistance) {
+                bestDistance = prefixDistance;
+                best = order;
+            }
+            return;
+        }
+
+        // The stops are placed first, then the schools
+        size_t groupEnd = depth <= numStops ? numStops + 1 : order.size();
+        for (size_t i = depth; i < groupEnd; ++i) {
+            std::swap(order[depth], order[i]);
+            std::swap(minEntry[depth], minEntry[i]);
+            double distance = prefixDistance + distanceMatrix.at(order[depth - 1], order[depth]);
+            double bound = remainingBound - minEntry[depth];
+            if (distance + bound < bestDistance) {
+                branch(depth + 1, distance, bound);
+            }
+            std::swap(minEntry[depth], minEntry[i]);
+            std::swap(order[depth], order[i]);
+        }
+    }
+
+    const DistanceMatrix& distanceMatrix;
+    size_t numStops;
+    std::vector<int> order; // Depot, then the stops, then the schools: order[0, depth) is the current prefix
+    std::vector<double> minEntry; // Cheapest arc entering order[v], swapped together with order
+    std::vector<int> best;
+    double bestDistance;
+};
+
+// Algorithm used by findOptimalRoute to order the bus stops and the schools of a route
+enum class RouteSequencing {
+    Automatic, // Held-Karp up to HELD_KARP_MAX_GROUP stops and schools, heuristic above
+    BranchAndBound, // Exact enumeration in place with pruning (BranchAndBoundSequencer)
+    Permutations // Every permutation of the stops times every permutation of the schools (the original procedure)
+};
+
+// Function to find the route with the smallest total distance (the bus stops first, then the schools).
+// If a cache is given, it is consulted before sequencing the nodes and it receives the result.
+void findOptimalRoute(Route& route, const std::vector<int>& clusterIDs, const DistanceMatrix& distanceMatrix, RouteCostCache* routeCache = nullptr,
+                      RouteSequencing sequencing = RouteSequencing::Automatic) {
+    if (routeCache != nullptr && routeCache->lookup(route)) {
+        return;
+    }
+
     // Extract visited nodes from route
     std::vector<int>& visitedNodes = route.visitedNodes;
 
@@ -826,6 +1044,22 @@ void findOptimalRoute(Route& route, const std::vector<int>& clusterIDs, const st
         }
     }
 
+    if (sequencing != RouteSequencing::Permutations) {
+        if (sequencing == RouteSequencing::BranchAndBound) {
+            route.visitedNodes = BranchAndBoundSequencer(depot, busStops, clusters, distanceMatrix).solve();
+        } else if (static_cast<int>(busStops.size()) <= HELD_KARP_MAX_GROUP && static_cast<int>(clusters.size()) <= HELD_KARP_MAX_GROUP) {
+            route.visitedNodes = sequenceRouteHeldKarp(depot, busStops, clusters, distanceMatrix);
+        } else {
+            route.visitedNodes = sequenceRouteHeuristic(depot, busStops, clusters, distanceMatrix);
+        }
+        route.cost = calculateTotalDistance(route.visitedNodes, distanceMatrix);
+        route.times.valid = false;
+        if (routeCache != nullptr) {
+            routeCache->store(route);
+        }
+        return;
+    }
+
     // Generate permutations of bus stops and clusters
     std::vector<std::vector<int>> busStopPermutations;
     std::vector<std::vector<int>> clusterPermutations;
@@ -838,8 +1072,6 @@ void findOptimalRoute(Route& route, const std::vector<int>& clusterIDs, const st
     std::vector<int> optimalRoute;
     double minDistance = std::numeric_limits<double>::max();
 
-    int permutationCounter = 0; // Counter for permutations
-
     for (const auto& busStopPerm : busStopPermutations) {
         for (const auto& clusterPerm : clusterPermutations) {
             std::vector<int> currentRoute = { depot };
@@ -847,22 +1079,19 @@ void findOptimalRoute(Route& route, const std::vector<int>& clusterIDs, const st
             currentRoute.insert(currentRoute.end(), clusterPerm.begin(), clusterPerm.end());
             double distance = calculateTotalDistance(currentRoute, distanceMatrix);
 
-            // Print permutation and its distance
-            //std::cout << "\nPermutation " << ++permutationCounter << ": ";
-            //for (size_t i = 0; i < currentRoute.size(); ++i) {
-            //    std::cout << currentRoute[i];
-            //    if (i < currentRoute.size() - 1) std::cout << " -> ";
-            //}
-            //std::cout << ", Distance: " << std::fixed << std::setprecision(2) << distance << std::endl;
-
             // Update route's visitedNodes if current route has smaller distance
             if (distance < minDistance) {
                 minDistance = distance;
                 route.visitedNodes = currentRoute;
+                route.cost = distance;
+                route.times.valid = false;
             }
         }
     }
-    std::cout << std::endl;
+
+    if (routeCache != nullptr) {
+        routeCache->store(route);
+    }
 }
 
 
@@ -880,149 +1109,743 @@ Route getRandomRoute(const std::vector<Route>& routes) {
 }
 
 
-// Function to add a node to a route after the depot
-void addNodeToRoute(Route& route, int nodeId, const std::vector<NodeDataRow>& nodesMatrix) {
+// Function to add a node to a route after the depot, with the children of loads (all the children of the node if loads is null).
+// If the route already serves the node, the children are added to its pickup and only the missing schools are added
+void addNodeToRoute(Route& route, int nodeId, const ProblemInstance& problemInstance, const int* loads = nullptr) {
     // Find the node with the given nodeId in the nodes matrix
-    auto it = std::find_if(nodesMatrix.begin(), nodesMatrix.end(), 
-                           [nodeId](const NodeDataRow& node) { return node.id1 == nodeId; });
+    const NodeDataRow* found = problemInstance.findNode(nodeId);
 
-    if (it == nodesMatrix.end()) {
+    if (found == nullptr) {
         std::cerr << "Node with ID " << nodeId << " not found in the nodes matrix.\n";
         return;
     }
 
-    const NodeDataRow& node = *it;
+    const NodeDataRow& node = *found;
+    const DistanceMatrix& distanceMatrix = problemInstance.getDistancesMatrix();
+    std::vector<int>& visitedNodes = route.visitedNodes;
+    if (loads == nullptr) {
+        loads = problemInstance.getNodeDemands(nodeId);
+    }
 
     // Insert the node after the depot (which is the first element in visitedNodes)
-    if (route.visitedNodes.size() > 1) {
-        route.visitedNodes.insert(route.visitedNodes.begin() + 1, node.id1);
+    if (findPickup(route, nodeId) != -1) {
+        // The route already visits the node
+    } else if (visitedNodes.size() > 1) {
+        route.cost += distanceMatrix.at(visitedNodes[0], node.id1) + distanceMatrix.at(node.id1, visitedNodes[1])
+                    - distanceMatrix.at(visitedNodes[0], visitedNodes[1]);
+        visitedNodes.insert(visitedNodes.begin() + 1, node.id1);
     } else {
-        route.visitedNodes.push_back(node.id1);
+        if (!visitedNodes.empty()) {
+            route.cost += distanceMatrix.at(visitedNodes.back(), node.id1);
+        }
+        visitedNodes.push_back(node.id1);
     }
 
     // Check and add clusters if needed
-    if (node.children_to_cluster_1 > 0 && route.childrenToCluster1 == 0) {
-        int clusterID = findClusterID(nodesMatrix, 1);
-        if (clusterID != -1) {
-            route.visitedNodes.push_back(clusterID);
+    for (int k = 0; k < route.numSchools; ++k) {
+        if (loads[k] > 0 && route.childrenToCluster[k] == 0) {
+            int clusterID = findClusterID(problemInstance, k + 1);
+            if (clusterID != -1) {
+                route.cost += distanceMatrix.at(visitedNodes.back(), clusterID);
+                visitedNodes.push_back(clusterID);
+            }
         }
     }
-    if (node.children_to_cluster_2 > 0 && route.childrenToCluster2 == 0) {
-        int clusterID = findClusterID(nodesMatrix, 2);
-        if (clusterID != -1) {
-            route.visitedNodes.push_back(clusterID);
+
+    // Update the children counts for the route
+    addPickup(route, nodeId, loads);
+}
+
+// Function to remove the schools that the children picked up by a route do not need anymore
+// (the cost is computed again, the order of the other nodes does not change)
+void removeUnusedSchools(Route& route, const ProblemInstance& problemInstance) {
+    std::vector<int>& visitedNodes = route.visitedNodes;
+    visitedNodes.erase(std::remove_if(visitedNodes.begin(), visitedNodes.end(), [&](int node) {
+        int ordinal = problemInstance.getClusterOrdinal(node);
+        return ordinal >= 1 && ordinal <= route.numSchools && route.childrenToCluster[ordinal - 1] == 0;
+    }), visitedNodes.end());
+    refreshRouteCache(route, problemInstance.getDistancesMatrix());
+}
+
+// Function to find a route that already serves a bus stop and can take demand more children (-1 if there is none)
+int findServingRouteWithRoom(const std::vector<Route>& routes, int busStop, int demand, const std::vector<int>& busesCapacities) {
+    for (size_t r = 0; r < routes.size(); ++r) {
+        if (findPickup(routes[r], busStop) != -1 && routes[r].load + demand <= busesCapacities[routes[r].busIndex - 1]) {
+            return static_cast<int>(r);
         }
     }
-    if (node.children_to_cluster_3 > 0 && route.childrenToCluster3 == 0) {
-        int clusterID = findClusterID(nodesMatrix, 3);
-        if (clusterID != -1) {
-            route.visitedNodes.push_back(clusterID);
+    return -1;
+}
+
+// Function to split the children of a bus stop that no route can take all together (loads, updated) among more routes:
+// the routes that already serve the stop are filled first, then the routes with the largest residual capacity,
+// while the stop is served by fewer than maxSplitsPerStop routes. Every changed route is ordered with findOptimalRoute.
+// It returns the changed routes (the children left in loads could not be placed)
+std::vector<int> splitStopOverRoutes(std::vector<Route>& routes, int busStop, int* loads, const ProblemInstance& problemInstance,
+                                     const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
+                                     const DistanceMatrix& distanceMatrix, RouteCostCache* routeCache = nullptr,
+                                     int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
+    const int numSchools = problemInstance.getNumberOfSchools();
+    auto residual = [&](int r) { return busesCapacities[routes[r].busIndex - 1] - routes[r].load; };
+
+    std::vector<int> order(routes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        bool servesA = findPickup(routes[a], busStop) != -1;
+        bool servesB = findPickup(routes[b], busStop) != -1;
+        return servesA != servesB ? servesA : residual(a) > residual(b);
+    });
+
+    std::vector<int> changed;
+    int splits = countServingRoutes(routes, busStop);
+    for (int r : order) {
+        if (totalSchoolLoad(loads, numSchools) == 0) {
+            break;
         }
+        bool serves = findPickup(routes[r], busStop) != -1;
+        if (residual(r) <= 0 || (!serves && splits >= maxSplitsPerStop)) {
+            continue;
+        }
+        SchoolLoads taken;
+        takeChildren(loads, numSchools, residual(r), taken);
+        addNodeToRoute(routes[r], busStop, problemInstance, taken.data());
+        findOptimalRoute(routes[r], clusterIDs, distanceMatrix, routeCache);
+        changed.push_back(r);
+        splits += serves ? 0 : 1;
+    }
+    return changed;
+}
+
+// Function to place the children of a node that no route picks up yet (unservedLoads of the node, cleared when placed):
+// into a route that already serves it if one has room, otherwise into a route drawn by draw (it returns -1 if no route
+// fits; no draw is made if the stop already has maxSplitsPerStop routes), otherwise split among more routes.
+// The loads of the changed routes are updated in the index; it returns false if some children of the node could not be placed
+template <typename Draw>
+bool placeUnservedNode(std::vector<Route>& routes, int nodeId, int* unservedLoads, ResidualCapacityIndex& index, Draw draw,
+                       const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
+                       const DistanceMatrix& distanceMatrix, RouteCostCache* routeCache, int maxSplitsPerStop, std::vector<int>& changed) {
+    const int numSchools = problemInstance.getNumberOfSchools();
+    int demand = totalSchoolLoad(unservedLoads, numSchools);
+    changed.clear();
+    if (demand == 0) {
+        return true; // Already served (e.g. a node given twice)
+    }
+
+    int routeIndex = findServingRouteWithRoom(routes, nodeId, demand, busesCapacities);
+    if (routeIndex == -1 && countServingRoutes(routes, nodeId) < maxSplitsPerStop) {
+        routeIndex = draw(demand);
+    }
+    if (routeIndex != -1) {
+        addNodeToRoute(routes[routeIndex], nodeId, problemInstance, unservedLoads);
+        findOptimalRoute(routes[routeIndex], clusterIDs, distanceMatrix, routeCache);
+        std::fill(unservedLoads, unservedLoads + numSchools, 0);
+        changed.push_back(routeIndex);
+    } else {
+        changed = splitStopOverRoutes(routes, nodeId, unservedLoads, problemInstance, busesCapacities, clusterIDs,
+                                      distanceMatrix, routeCache, maxSplitsPerStop);
     }
-    if (node.children_to_cluster_4 > 0 && route.childrenToCluster4 == 0) {
-        int clusterID = findClusterID(nodesMatrix, 4);
-        if (clusterID != -1) {
-            route.visitedNodes.push_back(clusterID);
+    for (int r : changed) {
+        index.updateRoute(r, routes[r], busesCapacities);
+    }
+    return totalSchoolLoad(unservedLoads, numSchools) == 0;
+}
+
+// Function to add a list of nodes to routes and find their optimal configurations.
+// Only the children of the nodes that no route picks up yet are added (a node split by the construction keeps its other routes).
+// It returns the nodes that do not fit in any route (they are reported on std::cerr)
+std::vector<int> addNodesAndFindOptimal(std::vector<Route>& routes, const std::vector<int>& nodeIds, const ProblemInstance& problemInstance,
+                            const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
+                            const DistanceMatrix& distanceMatrix, RouteCostCache* routeCache = nullptr,
+                            int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
+    ResidualCapacityIndex index(routes, busesCapacities, std::vector<double>(routes.size(), 1.0));
+    std::vector<int> unservedLoads = computeUnservedLoads(routes, problemInstance);
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> unplacedNodes;
+    std::vector<int> changed;
+
+    // Select a random route among the ones where the node's children fit within bus capacity
+    auto draw = [&](int demand) { return index.drawUniform(demand, randomUnit()); };
+    for (int nodeId : nodeIds) {
+        if (!placeUnservedNode(routes, nodeId, unservedLoads.data() + static_cast<size_t>(nodeId) * numSchools, index, draw,
+                               problemInstance, busesCapacities, clusterIDs, distanceMatrix, routeCache, maxSplitsPerStop, changed)) {
+            std::cerr << "Node " << nodeId << " does not fit in any route" << std::endl;
+            unplacedNodes.push_back(nodeId);
+        }
+    }
+    return unplacedNodes;
+}
+
+// Weight of a route in addNodesUsingProbabilityAndFindOptimal: inverse of its size (adding 1 to avoid division by zero)
+double inverseRouteSize(const Route& route) {
+    return 1.0 / (route.visitedNodes.size() + 1);
+}
+
+// Function to add a list of nodes to routes and find their optimal configurations (giving less pr do be chosen to larger routes)
+// Only the children of the nodes that no route picks up yet are added (a node split by the construction keeps its other routes).
+// It returns the nodes that do not fit in any route (they are reported on std::cerr)
+std::vector<int> addNodesUsingProbabilityAndFindOptimal(std::vector<Route>& routes, const std::vector<int>& nodeIds, const ProblemInstance& problemInstance,
+                            const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
+                            const DistanceMatrix& distanceMatrix, RouteCostCache* routeCache = nullptr,
+                            int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
+
+    // Calculate inverse of visitedNodes sizes
+    // E.g. [3, 4, 5] -> [1/4, 1/5, 1/6]
+    // They are not normalized: the index draws a route with a probability proportional to its weight
+    std::vector<double> inverseVisitedNodesSizes(routes.size());
+    for (size_t i = 0; i < routes.size(); ++i) { // Loop over routes
+        inverseVisitedNodesSizes[i] = inverseRouteSize(routes[i]);
+    }
+
+    // Routes indexed by residual capacity: a route is drawn among the ones where the node fits, based on inverseVisitedNodesSizes
+    ResidualCapacityIndex index(routes, busesCapacities, inverseVisitedNodesSizes);
+    std::vector<int> unservedLoads = computeUnservedLoads(routes, problemInstance);
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> unplacedNodes;
+    std::vector<int> changed;
+
+    auto draw = [&](int demand) { return index.drawWeighted(demand, randomUnit()); };
+    for (int nodeId : nodeIds) {
+        bool placed = placeUnservedNode(routes, nodeId, unservedLoads.data() + static_cast<size_t>(nodeId) * numSchools, index, draw,
+                                        problemInstance, busesCapacities, clusterIDs, distanceMatrix, routeCache, maxSplitsPerStop, changed);
+
+        // The changed routes are larger now: their loads are updated in the index by placeUnservedNode, their probabilities here in O(log R)
+        for (int r : changed) {
+            index.setWeight(r, inverseRouteSize(routes[r]));
+        }
+        if (!placed) {
+            std::cerr << "Node " << nodeId << " does not fit in any route" << std::endl;
+            unplacedNodes.push_back(nodeId);
+        }
+    }
+    return unplacedNodes;
+}
+
+// Best place of a stop in a route: the stop goes before visitedNodes[position], delta is the change of the distance
+// (position 0: the route already visits the stop, only its missing schools are added)
+struct Insertion {
+    int route = -1;
+    size_t position = 0;
+    double delta = std::numeric_limits<double>::infinity();
+};
+
+// Function to find the schools of the children (loads) of a node that a route does not visit yet
+std::vector<int> findMissingSchools(const Route& route, const int* loads, const ProblemInstance& problemInstance) {
+    std::vector<int> missingSchools;
+    for (int k = 0; k < route.numSchools; ++k) {
+        if (loads[k] > 0 && route.childrenToCluster[k] == 0) {
+            int clusterID = findClusterID(problemInstance, k + 1);
+            if (clusterID != -1) {
+                missingSchools.push_back(clusterID);
+            }
+        }
+    }
+    return missingSchools;
+}
+
+// Function to find the position of the first school of a route (visitedNodes.size() if it has none)
+size_t findFirstSchoolPosition(const Route& route, const ProblemInstance& problemInstance) {
+    for (size_t i = 1; i < route.visitedNodes.size(); ++i) {
+        if (problemInstance.getClusterOrdinal(route.visitedNodes[i]) != -1) {
+            return i;
+        }
+    }
+    return route.visitedNodes.size();
+}
+
+// Function to insert a stop before nodes[position] (nothing if position is 0), then each missing school at its cheapest
+// position after the stops (the schools start at firstSchool before the insertion). It returns the new total distance.
+double insertStopWithSchools(std::vector<int>& nodes, int nodeId, size_t position, size_t firstSchool,
+                             const std::vector<int>& missingSchools, const DistanceMatrix& distanceMatrix) {
+    if (position > 0) {
+        nodes.insert(nodes.begin() + position, nodeId);
+        firstSchool++;
+    }
+    for (int school : missingSchools) {
+        size_t bestPosition = nodes.size();
+        double bestDelta = std::numeric_limits<double>::infinity();
+        for (size_t q = firstSchool; q <= nodes.size(); ++q) {
+            double delta = distanceMatrix.at(nodes[q - 1], school);
+            if (q < nodes.size()) {
+                delta += distanceMatrix.at(school, nodes[q]) - distanceMatrix.at(nodes[q - 1], nodes[q]);
+            }
+            if (delta < bestDelta) {
+                bestDelta = delta;
+                bestPosition = q;
+            }
+        }
+        nodes.insert(nodes.begin() + bestPosition, school);
+    }
+    return calculateTotalDistance(nodes, distanceMatrix);
+}
+
+// Time-aware check of an insertion (defined with the time-aware evaluation below)
+struct TimeConstraints;
+bool isInsertionInTime(Route& route, size_t position, int nodeId, const int* loads, const std::vector<int>* newNodes,
+                       const ProblemInstance& problemInstance, const TimeConstraints& constraints);
+
+// Function to find the cheapest position of a stop among the stops of a route (it keeps the stops before the schools).
+// When the route already visits the schools of the stop, the delta of every position is d(prev, v) + d(v, next) - d(prev, next),
+// read for all the positions at once with DistanceMatrix::gatherArcs; otherwise the missing schools are inserted too
+// and each position is measured on the whole route. The children of loads are added to the stop if the route already
+// visits it (position 0); a route that does not visit it is skipped if newSplit is false (the stop has its maximum of routes).
+// The delta is infinite if the children do not fit in the bus. With timeConstraints, the positions that break the time
+// constraints are skipped (isInsertionInTime).
+Insertion findBestInsertion(Route& route, int routeIndex, int nodeId, const int* loads, const ProblemInstance& problemInstance,
+                            const std::vector<int>& busesCapacities, const DistanceMatrix& distanceMatrix, bool newSplit = true,
+                            const TimeConstraints* timeConstraints = nullptr) {
+    Insertion best;
+    best.route = routeIndex;
+    int demand = totalSchoolLoad(loads, route.numSchools);
+    if (route.load + demand > busesCapacities[route.busIndex - 1] || route.visitedNodes.empty()) {
+        return best;
+    }
+
+    const std::vector<int>& nodes = route.visitedNodes;
+    size_t firstSchool = findFirstSchoolPosition(route, problemInstance);
+    std::vector<int> missingSchools = findMissingSchools(route, loads, problemInstance);
+    auto inTime = [&](size_t position, const std::vector<int>* newNodes) {
+        return timeConstraints == nullptr || isInsertionInTime(route, position, nodeId, loads, newNodes, problemInstance, *timeConstraints);
+    };
+
+    if (findPickup(route, nodeId) != -1) {
+        std::vector<int> candidate = nodes;
+        double delta = missingSchools.empty() ? 0.0
+                     : insertStopWithSchools(candidate, nodeId, 0, firstSchool, missingSchools, distanceMatrix) - route.cost;
+        if (inTime(0, missingSchools.empty() ? nullptr : &candidate)) {
+            best.position = 0;
+            best.delta = delta;
+        }
+        return best;
+    }
+    if (!newSplit) {
+        return best;
+    }
+
+    if (!missingSchools.empty()) {
+        for (size_t p = 1; p <= firstSchool; ++p) {
+            std::vector<int> candidate = nodes;
+            double delta = insertStopWithSchools(candidate, nodeId, p, firstSchool, missingSchools, distanceMatrix) - route.cost;
+            if (delta < best.delta && inTime(p, &candidate)) {
+                best.delta = delta;
+                best.position = p;
+            }
+        }
+        return best;
+    }
+
+    // Positions 1 .. firstSchool with a next node; appending at the end (route without schools) has no next node
+    size_t numPositions = std::min(firstSchool, nodes.size() - 1);
+    thread_local std::vector<int32_t> stop, previous, next;
+    thread_local std::vector<double> toStop, fromStop, replaced;
+    stop.assign(numPositions, nodeId);
+    previous.assign(nodes.begin(), nodes.begin() + numPositions);
+    next.assign(nodes.begin() + 1, nodes.begin() + 1 + numPositions);
+    toStop.resize(numPositions);
+    fromStop.resize(numPositions);
+    replaced.resize(numPositions);
+    distanceMatrix.gatherArcs(previous.data(), stop.data(), numPositions, toStop.data());
+    distanceMatrix.gatherArcs(stop.data(), next.data(), numPositions, fromStop.data());
+    distanceMatrix.gatherArcs(previous.data(), next.data(), numPositions, replaced.data());
+
+    for (size_t k = 0; k < numPositions; ++k) {
+        double delta = toStop[k] + fromStop[k] - replaced[k];
+        if (delta < best.delta && inTime(k + 1, nullptr)) {
+            best.delta = delta;
+            best.position = k + 1;
+        }
+    }
+    if (firstSchool == nodes.size()) {
+        double delta = distanceMatrix.at(nodes.back(), nodeId);
+        if (delta < best.delta && inTime(nodes.size(), nullptr)) {
+            best.delta = delta;
+            best.position = nodes.size();
+        }
+    }
+    return best;
+}
+
+// Function to apply an insertion of the children of loads found by findBestInsertion
+void applyInsertion(Route& route, const Insertion& insertion, int nodeId, const int* loads, const ProblemInstance& problemInstance,
+                    const DistanceMatrix& distanceMatrix) {
+    std::vector<int> missingSchools = findMissingSchools(route, loads, problemInstance);
+    if (missingSchools.empty()) {
+        if (insertion.position > 0) {
+            route.visitedNodes.insert(route.visitedNodes.begin() + insertion.position, nodeId);
+        }
+        route.cost += insertion.delta;
+    } else {
+        size_t firstSchool = findFirstSchoolPosition(route, problemInstance);
+        route.cost = insertStopWithSchools(route.visitedNodes, nodeId, insertion.position, firstSchool, missingSchools, distanceMatrix);
+    }
+    addPickup(route, nodeId, loads);
+}
+
+// Function to insert a list of nodes into the routes greedily, every node at its best (route, position) by the exact insertion delta.
+// With regretK <= 1 (cheapest insertion) the node with the cheapest insertion is placed first; with regretK >= 2 (regret-k)
+// the node with the largest regret, the sum of the differences between its k best routes and its best one, is placed first
+// (a node with fewer than k routes where it fits comes before the others). After an insertion only the changed route is scored again.
+// Only the children of the nodes that no route picks up yet are inserted; the nodes that fit in no route are then split among
+// more routes (splitStopOverRoutes, at most maxSplitsPerStop routes per node).
+// With timeConstraints only the positions that keep the time constraints are used; when no node has one left, the
+// remaining nodes are inserted without them (their violation is paid by the penalty of the time-aware objective).
+// It returns the nodes that do not fit in any route (they are reported on std::cerr)
+std::vector<int> insertNodesGreedy(std::vector<Route>& routes, const std::vector<int>& nodeIds, const ProblemInstance& problemInstance,
+                                   const std::vector<int>& busesCapacities, const DistanceMatrix& distanceMatrix, int regretK = 1,
+                                   int maxSplitsPerStop = MAX_SPLITS_PER_STOP, const TimeConstraints* timeConstraints = nullptr) {
+    const int numSchools = problemInstance.getNumberOfSchools();
+    std::vector<int> unservedLoads = computeUnservedLoads(routes, problemInstance);
+    auto loadsOf = [&](int nodeId) { return unservedLoads.data() + static_cast<size_t>(nodeId) * numSchools; };
+
+    std::vector<int> pending;
+    std::vector<bool> newSplit; // The node can still be given to a route that does not serve it
+    for (int nodeId : nodeIds) {
+        if (totalSchoolLoad(loadsOf(nodeId), numSchools) > 0 && std::find(pending.begin(), pending.end(), nodeId) == pending.end()) {
+            pending.push_back(nodeId);
+            newSplit.push_back(countServingRoutes(routes, nodeId) < maxSplitsPerStop);
+        }
+    }
+    std::vector<int> unplacedNodes;
+
+    // best[u][r]: best insertion of pending[u] in routes[r]
+    std::vector<std::vector<Insertion>> best(pending.size(), std::vector<Insertion>(routes.size()));
+    for (size_t u = 0; u < pending.size(); ++u) {
+        for (size_t r = 0; r < routes.size(); ++r) {
+            best[u][r] = findBestInsertion(routes[r], static_cast<int>(r), pending[u], loadsOf(pending[u]), problemInstance,
+                                           busesCapacities, distanceMatrix, newSplit[u], timeConstraints);
+        }
+    }
+
+    while (!pending.empty()) {
+        int chosen = -1;
+        Insertion chosenInsertion;
+        int chosenMissing = 0;
+        double chosenRegret = -1.0;
+
+        for (size_t u = 0; u < pending.size(); ++u) {
+            // The k cheapest routes of the node
+            std::vector<double> deltas;
+            Insertion cheapest;
+            for (const Insertion& insertion : best[u]) {
+                if (insertion.delta < std::numeric_limits<double>::infinity()) {
+                    deltas.push_back(insertion.delta);
+                    if (insertion.delta < cheapest.delta) {
+                        cheapest = insertion;
+                    }
+                }
+            }
+            if (deltas.empty()) {
+                continue;
+            }
+
+            int missing = 0;
+            double regret = 0.0;
+            if (regretK >= 2) {
+                size_t k = std::min<size_t>(regretK, deltas.size());
+                std::partial_sort(deltas.begin(), deltas.begin() + k, deltas.end());
+                for (size_t h = 1; h < k; ++h) {
+                    regret += deltas[h] - deltas[0];
+                }
+                missing = regretK - static_cast<int>(k);
+            }
+
+            bool better;
+            if (chosen == -1) {
+                better = true;
+            } else if (regretK < 2) {
+                better = cheapest.delta < chosenInsertion.delta;
+            } else if (missing != chosenMissing) {
+                better = missing > chosenMissing;
+            } else if (regret != chosenRegret) {
+                better = regret > chosenRegret;
+            } else {
+                better = cheapest.delta < chosenInsertion.delta;
+            }
+            if (better) {
+                chosen = static_cast<int>(u);
+                chosenInsertion = cheapest;
+                chosenMissing = missing;
+                chosenRegret = regret;
+            }
+        }
+
+        // No position keeps the time constraints: the remaining nodes are scored again without them
+        if (chosen == -1 && timeConstraints != nullptr) {
+            timeConstraints = nullptr;
+            for (size_t u = 0; u < pending.size(); ++u) {
+                for (size_t r = 0; r < routes.size(); ++r) {
+                    best[u][r] = findBestInsertion(routes[r], static_cast<int>(r), pending[u], loadsOf(pending[u]), problemInstance,
+                                                   busesCapacities, distanceMatrix, newSplit[u]);
+                }
+            }
+            continue;
+        }
+
+        // The nodes that fit in no route now will not fit later (the loads only grow): they are split among more routes
+        if (chosen == -1) {
+            for (int nodeId : pending) {
+                splitStopOverRoutes(routes, nodeId, loadsOf(nodeId), problemInstance, busesCapacities, findAllClusterIDs(problemInstance),
+                                    distanceMatrix, nullptr, maxSplitsPerStop);
+                if (totalSchoolLoad(loadsOf(nodeId), numSchools) > 0) {
+                    std::cerr << "Node " << nodeId << " does not fit in any route" << std::endl;
+                    unplacedNodes.push_back(nodeId);
+                }
+            }
+            break;
+        }
+
+        int nodeId = pending[chosen];
+        applyInsertion(routes[chosenInsertion.route], chosenInsertion, nodeId, loadsOf(nodeId), problemInstance, distanceMatrix);
+        std::fill(loadsOf(nodeId), loadsOf(nodeId) + numSchools, 0);
+        pending.erase(pending.begin() + chosen);
+        newSplit.erase(newSplit.begin() + chosen);
+        best.erase(best.begin() + chosen);
+        for (size_t u = 0; u < pending.size(); ++u) {
+            best[u][chosenInsertion.route] = findBestInsertion(routes[chosenInsertion.route], chosenInsertion.route, pending[u], loadsOf(pending[u]),
+                                                               problemInstance, busesCapacities, distanceMatrix, newSplit[u], timeConstraints);
+        }
+    }
+
+    return unplacedNodes;
+}
+
+// Saving of serving stop j right after stop i in the same route, instead of in two routes (Clarke-Wright)
+struct Saving {
+    int i;
+    int j;
+    double value;
+};
+
+// Function to build the routes with the Clarke-Wright savings for the mixed-load school case.
+// Every bus stop starts in its own chain depot -> stop -> schools. The saving of linking stop i to stop j is
+// d(depot, j) + d(i, nearest school of i) - d(i, j): the arc from the depot to j and the arc from i to the schools
+// are replaced by the arc i -> j. The savings are processed in decreasing order and every chain can grow (parallel version):
+// the chain ending at i is merged with the chain starting at j if the load fits the largest bus.
+// The chains are then given to the buses, the largest chain to the smallest bus that takes it, and every route is ordered
+// with findOptimalRoute. With randomization > 0 every saving is multiplied by a random factor in [1 - randomization, 1 + randomization],
+// to build different solutions. The stops of the chains left without a bus are returned as unserved.
+std::pair<std::vector<Route>, std::vector<int>> buildRoutesSavings(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities,
+                                                                   double randomization = 0.0, RouteCostCache* routeCache = nullptr) {
+    const DistanceMatrix& distanceMatrix = problemInstance.getDistancesMatrix();
+    const int numSchools = problemInstance.getNumberOfSchools();
+    const std::vector<int>& clusterIDs = findAllClusterIDs(problemInstance);
+    int depot = problemInstance.getDepotID();
+    std::vector<int> busStops = problemInstance.getBusStopIDs();
+    int maxCapacity = busesCapacities.empty() ? 0 : *std::max_element(busesCapacities.begin(), busesCapacities.end());
+
+    std::vector<Route> routes;
+    std::vector<int> unservedBusStops;
+
+    // One chain per bus stop (a stop larger than every bus cannot be served by a single route: the repair splits it)
+    std::vector<std::vector<int>> chains;
+    std::vector<int> chainLoads;
+    std::vector<int> chainOf(distanceMatrix.size(), -1);
+    for (int busStop : busStops) {
+        int demand = problemInstance.getNodeTotalDemand(busStop);
+        if (demand > maxCapacity) {
+            unservedBusStops.push_back(busStop);
+            continue;
+        }
+        chainOf[busStop] = static_cast<int>(chains.size());
+        chains.push_back({ busStop });
+        chainLoads.push_back(demand);
+    }
+
+    // Cost of leaving a stop towards the schools of its children (all the schools if it has none)
+    auto exitCost = [&](int busStop) {
+        const int* demands = problemInstance.getNodeDemands(busStop);
+        double cheapest = std::numeric_limits<double>::infinity();
+        double cheapestAny = std::numeric_limits<double>::infinity();
+        for (int k = 0; k < numSchools; ++k) {
+            int clusterID = findClusterID(problemInstance, k + 1);
+            if (clusterID == -1) {
+                continue;
+            }
+            cheapestAny = std::min(cheapestAny, distanceMatrix.at(busStop, clusterID));
+            if (demands[k] > 0) {
+                cheapest = std::min(cheapest, distanceMatrix.at(busStop, clusterID));
+            }
+        }
+        return cheapest < std::numeric_limits<double>::infinity() ? cheapest : cheapestAny;
+    };
+
+    std::mt19937& gen = randomEngine();
+    std::uniform_real_distribution<double> noise(1.0 - randomization, 1.0 + randomization);
+
+    std::vector<Saving> savings;
+    for (size_t a = 0; a < chains.size(); ++a) {
+        int i = chains[a][0];
+        double exit = exitCost(i);
+        for (size_t b = 0; b < chains.size(); ++b) {
+            int j = chains[b][0];
+            if (a == b) {
+                continue;
+            }
+            double value = distanceMatrix.at(depot, j) + exit - distanceMatrix.at(i, j);
+            if (randomization > 0.0) {
+                value *= noise(gen);
+            }
+            if (value > 0.0) {
+                savings.push_back({ i, j, value });
+            }
+        }
+    }
+    std::sort(savings.begin(), savings.end(), [](const Saving& x, const Saving& y) { return x.value > y.value; });
+
+    // Merge the chain ending at i with the chain starting at j
+    for (const Saving& saving : savings) {
+        int chainI = chainOf[saving.i];
+        int chainJ = chainOf[saving.j];
+        if (chainI == chainJ || chains[chainI].back() != saving.i || chains[chainJ].front() != saving.j) {
+            continue;
+        }
+        if (chainLoads[chainI] + chainLoads[chainJ] > maxCapacity) {
+            continue;
         }
+        for (int busStop : chains[chainJ]) {
+            chains[chainI].push_back(busStop);
+            chainOf[busStop] = chainI;
+        }
+        chainLoads[chainI] += chainLoads[chainJ];
+        chains[chainJ].clear();
+        chainLoads[chainJ] = 0;
     }
 
-    // Update the children counts for the route
-    route.childrenToCluster1 += node.children_to_cluster_1;
-    route.childrenToCluster2 += node.children_to_cluster_2;
-    route.childrenToCluster3 += node.children_to_cluster_3;
-    route.childrenToCluster4 += node.children_to_cluster_4;
-}
-
- // Function to add a node to a random route from routes and find its optimal configuration
-static void addNodeAndFindOptimal(std::vector<Route>& routes, int nodeId, const std::vector<NodeDataRow>& nodesMatrix,
-                                  const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
-                                  const std::vector<std::vector<double>>& distanceMatrix)
-                                  {
-    bool canAdd = false;
-    // Loop until we find a route where we can add the node within bus capacity
-    while (!canAdd) {
-        // Select a random index in the range [0, routes.size()-1]
-        int randomIndex = std::rand() % routes.size();
-
-        // Check if we can add the node's children to rPrime within bus capacity
-        canAdd = canAddNodeToRoute(nodesMatrix, routes[randomIndex], nodeId, busesCapacities);
-        // If we can add the node, update rPrime's visitedNodes and find its optimal configuration
-        if (canAdd) {
-            addNodeToRoute(routes[randomIndex], nodeId, nodesMatrix);
-            findOptimalRoute(routes[randomIndex], clusterIDs, distanceMatrix);
+    // Assign the chains to the buses: the largest chain first, to the smallest free bus that can take it
+    std::vector<int> chainOrder;
+    for (size_t c = 0; c < chains.size(); ++c) {
+        if (!chains[c].empty()) {
+            chainOrder.push_back(static_cast<int>(c));
         }
     }
-}
+    std::sort(chainOrder.begin(), chainOrder.end(), [&](int x, int y) { return chainLoads[x] > chainLoads[y]; });
+    std::vector<bool> busUsed(busesCapacities.size(), false);
 
+    for (int c : chainOrder) {
+        int bestBus = -1;
+        for (size_t bus = 0; bus < busesCapacities.size(); ++bus) {
+            if (!busUsed[bus] && busesCapacities[bus] >= chainLoads[c] &&
+                (bestBus == -1 || busesCapacities[bus] < busesCapacities[bestBus])) {
+                bestBus = static_cast<int>(bus);
+            }
+        }
+        if (bestBus == -1) {
+            unservedBusStops.insert(unservedBusStops.end(), chains[c].begin(), chains[c].end());
+            continue;
+        }
+        busUsed[bestBus] = true;
 
-// Function to add a list of nodes to routes and find their optimal configurations
-void addNodesAndFindOptimal(std::vector<Route>& routes, const std::vector<int>& nodeIds, const std::vector<NodeDataRow>& nodesMatrix,
-                            const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
-                            const std::vector<std::vector<double>>& distanceMatrix) {
-    for (int nodeId : nodeIds) {
-        bool canAdd = false;
-        // Loop until we find a route where we can add the node within bus capacity
-        while (!canAdd) {
-            // Select a random index in the range [0, routes.size()-1]
-            int randomIndex = std::rand() % routes.size();
-
-            // Check if we can add the node's children to rPrime within bus capacity
-            canAdd = canAddNodeToRoute(nodesMatrix, routes[randomIndex], nodeId, busesCapacities);
-            // If we can add the node, update rPrime's visitedNodes and find its optimal configuration
-            if (canAdd) {
-                addNodeToRoute(routes[randomIndex], nodeId, nodesMatrix);
-                findOptimalRoute(routes[randomIndex], clusterIDs, distanceMatrix);
+        Route route(bestBus + 1, numSchools); // Bus index should be 1-based
+        route.visitedNodes.push_back(depot);
+        for (int busStop : chains[c]) {
+            route.visitedNodes.push_back(busStop);
+            addPickup(route, busStop, problemInstance.getNodeDemands(busStop));
+        }
+        for (int k = 0; k < numSchools; ++k) {
+            int clusterID = findClusterID(problemInstance, k + 1);
+            if (route.childrenToCluster[k] > 0 && clusterID != -1) {
+                route.visitedNodes.push_back(clusterID);
             }
         }
+        refreshRouteCache(route, distanceMatrix);
+        findOptimalRoute(route, clusterIDs, distanceMatrix, routeCache);
+        routes.push_back(route);
     }
+
+    return {routes, unservedBusStops};
 }
 
-// Function to add a list of nodes to routes and find their optimal configurations (giving less pr do be chosen to larger routes)
-void addNodesUsingProbabilityAndFindOptimal(std::vector<Route>& routes, const std::vector<int>& nodeIds, const std::vector<NodeDataRow>& nodesMatrix,
-                            const std::vector<int>& busesCapacities, const std::vector<int>& clusterIDs,
-                            const std::vector<std::vector<double>>& distanceMatrix) {
+// Pi for the angles of the sweep (M_PI is not standard C++)
+constexpr double PI = 3.14159265358979323846;
+
+// Function to build the routes with a sweep around the depot: the bus stops are sorted by their polar angle around the depot
+// (in the plane of the two coordinates of the nodes matrix), starting from startAngle (radians), and the sequence is cut
+// into groups that fit the buses, the largest bus first. Every group is one route, ordered by findOptimalRoute.
+// The stops larger than every bus, and the ones left when the buses are over, are returned as unserved. O(n log n) plus the ordering.
+std::pair<std::vector<Route>, std::vector<int>> buildRoutesSweep(const ProblemInstance& problemInstance, const std::vector<int>& busesCapacities,
+                                                                 double startAngle, RouteCostCache* routeCache = nullptr) {
+    const DistanceMatrix& distanceMatrix = problemInstance.getDistancesMatrix();
+    const int numSchools = problemInstance.getNumberOfSchools();
+    const std::vector<int>& clusterIDs = findAllClusterIDs(problemInstance);
+    int depot = problemInstance.getDepotID();
+    const NodeDataRow* depotRow = problemInstance.findNode(depot);
 
-    // Calculate inverse of visitedNodes sizes
-    // E.g. [3, 4, 5] -> [1/4, 1/5, 1/6]
-    std::vector<double> inverseVisitedNodesSizes(routes.size()); // Initialize with zeros a vector of size routes.size()
-    for (size_t i = 0; i < routes.size(); ++i) { // Loop over routes
-        inverseVisitedNodesSizes[i] = 1.0 / (routes[i].visitedNodes.size() + 1); // Calculate inverse of size of visitedNodes (adding 1 to avoid division by zero)
+    std::vector<Route> routes;
+    std::vector<int> unservedBusStops;
+    if (depotRow == nullptr) {
+        return {routes, problemInstance.getBusStopIDs()};
+    }
+
+    // Angle of every stop, measured from startAngle in [0, 2 pi)
+    std::vector<std::pair<double, int>> sweep;
+    for (int busStop : problemInstance.getBusStopIDs()) {
+        const NodeDataRow* row = problemInstance.findNode(busStop);
+        double angle = std::atan2(row->longitude - depotRow->longitude, row->latitude - depotRow->latitude) - startAngle;
+        angle = std::fmod(angle, 2.0 * PI);
+        if (angle < 0.0) {
+            angle += 2.0 * PI;
+        }
+        sweep.emplace_back(angle, busStop);
     }
+    std::sort(sweep.begin(), sweep.end());
 
-    // Normalize inverseVisitedNodesSizes to form a probability distribution
-    // E.g. 0.1, 0.2, 0.3 -> 0.1/0.6, 0.2/0.6, 0.3/0.6 -> 0.1667, 0.3333, 0.5 (which sum is 1.0)
-    double totalInverse = std::accumulate(inverseVisitedNodesSizes.begin(), inverseVisitedNodesSizes.end(), 0.0); // Calculate the sum of inverseVisitedNodesSizes
-    std::transform(inverseVisitedNodesSizes.begin(), inverseVisitedNodesSizes.end(), inverseVisitedNodesSizes.begin(), 
-                   [totalInverse](double inv) { return inv / totalInverse; }); // Normalize inverseVisitedNodesSizes
+    // Buses from the largest to the smallest
+    std::vector<int> busOrder(busesCapacities.size());
+    std::iota(busOrder.begin(), busOrder.end(), 0);
+    std::stable_sort(busOrder.begin(), busOrder.end(), [&](int a, int b) { return busesCapacities[a] > busesCapacities[b]; });
+    int maxCapacity = busesCapacities.empty() ? 0 : busesCapacities[busOrder[0]];
 
-    for (int nodeId : nodeIds) {
-        bool canAdd = false;
-        // Loop until we find a route where we can add the node within bus capacity
-        while (!canAdd) {
-            // Randomly select a route index based on inverseVisitedNodesSizes
-            double randVal = static_cast<double>(std::rand()) / RAND_MAX; // Generate a random value in the range [0, 1)
-            double cumulativeProb = 0.0;
-            size_t randomIndex = 0;
-            for (; randomIndex < routes.size(); ++randomIndex) { // Loop over routes
-                cumulativeProb += inverseVisitedNodesSizes[randomIndex]; // Add the probability of the current route
-                if (randVal <= cumulativeProb) { // Check if the random value is less than or equal to the cumulative probability
-                    break;
-                }
-            }
+    size_t nextBus = 0;
+    std::vector<int> group;
+    int groupLoad = 0;
 
-            // Check if we can add the node's children to routes[randomIndex] within bus capacity
-            canAdd = canAddNodeToRoute(nodesMatrix, routes[randomIndex], nodeId, busesCapacities);
-            // If we can add the node, update routes[randomIndex]'s visitedNodes and find its optimal configuration
-            if (canAdd) {
-                addNodeToRoute(routes[randomIndex], nodeId, nodesMatrix);
-                findOptimalRoute(routes[randomIndex], clusterIDs, distanceMatrix);
+    // Function to close the current group into a route of the next bus
+    auto closeGroup = [&]() {
+        if (group.empty()) {
+            return;
+        }
+        if (nextBus == busOrder.size()) {
+            unservedBusStops.insert(unservedBusStops.end(), group.begin(), group.end());
+        } else {
+            Route route(busOrder[nextBus++] + 1, numSchools); // Bus index should be 1-based
+            route.visitedNodes.push_back(depot);
+            for (int busStop : group) {
+                route.visitedNodes.push_back(busStop);
+                addPickup(route, busStop, problemInstance.getNodeDemands(busStop));
+            }
+            for (int k = 0; k < numSchools; ++k) {
+                int clusterID = findClusterID(problemInstance, k + 1);
+                if (route.childrenToCluster[k] > 0 && clusterID != -1) {
+                    route.visitedNodes.push_back(clusterID);
+                }
             }
+            refreshRouteCache(route, distanceMatrix);
+            findOptimalRoute(route, clusterIDs, distanceMatrix, routeCache);
+            routes.push_back(route);
+        }
+        group.clear();
+        groupLoad = 0;
+    };
+
+    for (const auto& [angle, busStop] : sweep) {
+        int demand = problemInstance.getNodeTotalDemand(busStop);
+        if (demand > maxCapacity) {
+            unservedBusStops.push_back(busStop);
+            continue;
+        }
+        int capacity = nextBus < busOrder.size() ? busesCapacities[busOrder[nextBus]] : maxCapacity;
+        if (groupLoad + demand > capacity) {
+            closeGroup();
         }
+        group.push_back(busStop);
+        groupLoad += demand;
     }
+    closeGroup();
+
+    return {routes, unservedBusStops};
 }
 
 // Function to calculate the fitness of a Route based on visited nodes and distance matrix
-double calculateRouteFitness(const Route& route, const std::vector<std::vector<double>>& distanceMatrix) {
+double calculateRouteFitness(const Route& route, const DistanceMatrix& distanceMatrix) {
     double totalDistance = 0.0;
 
     const std::vector<int>& visitedNodes = route.visitedNodes;
@@ -1030,14 +1853,14 @@ double calculateRouteFitness(const Route& route, const std::vector<std::vector<d
     for (size_t i = 0; i < visitedNodes.size() - 1; i++) {
         int fromNode = visitedNodes[i];
         int toNode = visitedNodes[i + 1];
-        totalDistance += distanceMatrix[fromNode + 1][toNode + 1]; // It is 1 based index
+        totalDistance += distanceMatrix.at(fromNode, toNode);
     }
 
     return totalDistance;
 }
 
 // Function to calculate the total fitness of all routes in a vector
-double calculateRoutesFitness(const std::vector<Route>& routes, const std::vector<std::vector<double>>& distanceMatrix) {
+double calculateRoutesFitness(const std::vector<Route>& routes, const DistanceMatrix& distanceMatrix) {
     double totalFitness = 0.0;
 
     for (const auto& route : routes) {
@@ -1047,6 +1870,233 @@ double calculateRoutesFitness(const std::vector<Route>& routes, const std::vecto
     return totalFitness;
 }
 
+// ----------------- Time-aware evaluation -----------------
+
+// Constraints and objective of the time-aware evaluation (times in the unit of timesMatrix, i.e. seconds).
+// Objective of a route: alpha * distance + (1 - alpha) * weighted ride time + violationPenalty * violation.
+// The ride time of a child is the time from its stop to its school; the children of a stop are counted
+// with the pickup of the stop in the route, so a stop split among more buses counts each part in its own route.
+struct TimeConstraints {
+    double alpha = 1.0;
+    double maxRideTime = std::numeric_limits<double>::infinity();
+    double schoolDeadline = std::numeric_limits<double>::infinity(); // Latest arrival at a school after leaving the depot
+    double violationPenalty = 1000.0;
+};
+
+// Times within this tolerance of a limit are not a violation in the constant time checks (rounding of the sums)
+const double TIME_TOLERANCE = 1e-6;
+
+// Function to fill the time summaries of a route
+void computeRouteTimes(Route& route, const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    const DistanceMatrix& timesMatrix = problemInstance.getTimesMatrix();
+    const std::vector<int>& visitedNodes = route.visitedNodes;
+    const size_t n = visitedNodes.size();
+    const double infinity = std::numeric_limits<double>::infinity();
+    RouteTimes& times = route.times;
+
+    times.arrival.assign(n, 0.0);
+    for (size_t p = 1; p < n; ++p) {
+        times.arrival[p] = times.arrival[p - 1] + timesMatrix.at(visitedNodes[p - 1], visitedNodes[p]);
+    }
+
+    times.schoolArrival.assign(route.numSchools, -1.0);
+    times.deadlineSlackSuffix.assign(n + 1, infinity);
+    times.violation = 0.0;
+    for (size_t p = n; p-- > 0;) {
+        times.deadlineSlackSuffix[p] = times.deadlineSlackSuffix[p + 1];
+        int ordinal = problemInstance.getClusterOrdinal(visitedNodes[p]);
+        if (ordinal >= 1 && ordinal <= route.numSchools) {
+            double slack = constraints.schoolDeadline - times.arrival[p];
+            times.schoolArrival[ordinal - 1] = std::max(times.schoolArrival[ordinal - 1], times.arrival[p]);
+            times.deadlineSlackSuffix[p] = std::min(times.deadlineSlackSuffix[p], slack);
+            times.violation += std::max(0.0, -slack);
+        }
+    }
+
+    times.lastSchoolArrival.assign(n, -infinity);
+    times.rideSlack.assign(n, infinity);
+    times.rideSlackPrefix.assign(n, infinity);
+    times.weightedRideTime = 0.0;
+    for (size_t p = 0; p < n; ++p) {
+        int e = findPickup(route, visitedNodes[p]);
+        if (e != -1) {
+            const int* demands = getPickupLoads(route, e);
+            for (int k = 0; k < route.numSchools; ++k) {
+                if (demands[k] > 0 && times.schoolArrival[k] >= 0.0) {
+                    times.lastSchoolArrival[p] = std::max(times.lastSchoolArrival[p], times.schoolArrival[k]);
+                    times.weightedRideTime += demands[k] * (times.schoolArrival[k] - times.arrival[p]);
+                }
+            }
+            if (times.lastSchoolArrival[p] > -infinity) {
+                times.rideSlack[p] = constraints.maxRideTime - (times.lastSchoolArrival[p] - times.arrival[p]);
+                times.violation += std::max(0.0, -times.rideSlack[p]);
+            }
+        }
+        times.rideSlackPrefix[p] = (p > 0) ? std::min(times.rideSlackPrefix[p - 1], times.rideSlack[p]) : times.rideSlack[p];
+    }
+
+    times.maxRideTime = constraints.maxRideTime;
+    times.schoolDeadline = constraints.schoolDeadline;
+    times.valid = true;
+}
+
+// Function to compute the time summaries of a route again if the route changed or if they were computed with other constraints
+void updateRouteTimes(Route& route, const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    const RouteTimes& times = route.times;
+    if (!times.valid || times.maxRideTime != constraints.maxRideTime || times.schoolDeadline != constraints.schoolDeadline) {
+        computeRouteTimes(route, problemInstance, constraints);
+    }
+}
+
+// Function to calculate the time-aware objective of a route (the distance is the cached cost of the route)
+double calculateRouteFitness(Route& route, const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    updateRouteTimes(route, problemInstance, constraints);
+    return constraints.alpha * route.cost
+         + (1.0 - constraints.alpha) * route.times.weightedRideTime
+         + constraints.violationPenalty * route.times.violation;
+}
+
+// Function to calculate the time-aware objective of all routes in a vector
+double calculateRoutesFitness(std::vector<Route>& routes, const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    double totalFitness = 0.0;
+    for (Route& route : routes) {
+        totalFitness += calculateRouteFitness(route, problemInstance, constraints);
+    }
+    return totalFitness;
+}
+
+// Function to check in constant time (O(number of schools)) if a stop can be inserted at a position of the route
+// (before position, which must be after the depot and not after the first school) without breaking the
+// time constraints, with the children of loads (all the children of the stop if loads is null).
+// The schools of the children must already be in the route (route.times is computed again if it is not up to date).
+bool canInsertStopInTime(Route& route, size_t position, int nodeId, const ProblemInstance& problemInstance, const TimeConstraints& constraints,
+                         const int* loads = nullptr) {
+    updateRouteTimes(route, problemInstance, constraints);
+    const DistanceMatrix& timesMatrix = problemInstance.getTimesMatrix();
+    const RouteTimes& times = route.times;
+    int previous = route.visitedNodes[position - 1];
+    int next = route.visitedNodes[position];
+
+    // Everything after the new stop arrives later by extraTime
+    double extraTime = timesMatrix.at(previous, nodeId) + timesMatrix.at(nodeId, next) - timesMatrix.at(previous, next);
+    if (extraTime > times.deadlineSlackSuffix[position] + TIME_TOLERANCE || extraTime > times.rideSlackPrefix[position - 1] + TIME_TOLERANCE) {
+        return false;
+    }
+
+    // Ride time of the children of the new stop
+    double arrival = times.arrival[position - 1] + timesMatrix.at(previous, nodeId);
+    const int* demands = (loads != nullptr) ? loads : problemInstance.getNodeDemands(nodeId);
+    for (int k = 0; k < route.numSchools; ++k) {
+        if (demands[k] > 0 && times.schoolArrival[k] >= 0.0 && times.schoolArrival[k] + extraTime - arrival > constraints.maxRideTime + TIME_TOLERANCE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if the stops at positions i and j of the route can be swapped without breaking the
+// time constraints (both stops before the first school; route.times is computed again if it is not up to date).
+// It takes constant time, unless the stops between i and j are close to maxRideTime: then they are checked one by one.
+bool canSwapStopsInTime(Route& route, size_t i, size_t j, const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    if (i == j) {
+        return true;
+    }
+    updateRouteTimes(route, problemInstance, constraints);
+    if (i > j) {
+        std::swap(i, j);
+    }
+    const DistanceMatrix& timesMatrix = problemInstance.getTimesMatrix();
+    const RouteTimes& times = route.times;
+    const std::vector<int>& v = route.visitedNodes;
+
+    // New arrival at i, at i + 1 .. j - 1 (all shifted by middleShift), at j and at the rest of the route
+    double arrivalI = times.arrival[i - 1] + timesMatrix.at(v[i - 1], v[j]);
+    double middleShift = 0.0;
+    double arrivalJ;
+    if (j == i + 1) {
+        arrivalJ = arrivalI + timesMatrix.at(v[j], v[i]);
+    } else {
+        middleShift = arrivalI + timesMatrix.at(v[j], v[i + 1]) - times.arrival[i + 1];
+        arrivalJ = times.arrival[j - 1] + middleShift + timesMatrix.at(v[j - 1], v[i]);
+    }
+    double tailShift = arrivalJ + timesMatrix.at(v[i], v[j + 1]) - times.arrival[j + 1];
+
+    // Schools and stops before i
+    if (tailShift > times.deadlineSlackSuffix[j + 1] + TIME_TOLERANCE || tailShift > times.rideSlackPrefix[i - 1] + TIME_TOLERANCE) {
+        return false;
+    }
+
+    // Stops between i and j: the prefix minimum is a lower bound of their slack
+    double middleIncrease = tailShift - middleShift;
+    if (j > i + 1 && middleIncrease > times.rideSlackPrefix[j - 1] + TIME_TOLERANCE) {
+        for (size_t k = i + 1; k < j; ++k) {
+            if (middleIncrease > times.rideSlack[k] + TIME_TOLERANCE) {
+                return false;
+            }
+        }
+    }
+
+    // The two swapped stops
+    return times.lastSchoolArrival[j] + tailShift - arrivalI <= constraints.maxRideTime + TIME_TOLERANCE &&
+           times.lastSchoolArrival[i] + tailShift - arrivalJ <= constraints.maxRideTime + TIME_TOLERANCE;
+}
+
+// Function to check an answer of the constant time checks against a full computeRouteTimes of the route changed by change
+// (only with DEBUG_DELTA_EVALUATION). The checks assume that the route keeps the constraints, so other routes are not checked.
+template <typename Change>
+void checkTimeAnswer(const Route& route, Change change, bool answer, const ProblemInstance& problemInstance,
+                     const TimeConstraints& constraints, const char* checkName) {
+#ifdef DEBUG_DELTA_EVALUATION
+    if (route.times.violation > TIME_TOLERANCE) {
+        return;
+    }
+    Route changedRoute = route;
+    change(changedRoute);
+    computeRouteTimes(changedRoute, problemInstance, constraints);
+    bool recomputed = changedRoute.times.violation <= TIME_TOLERANCE;
+    if (answer != recomputed) {
+        std::ostringstream message;
+        message << std::setprecision(17) << checkName << ": bus " << route.busIndex << " answered " << answer
+                << " but the changed route has violation " << changedRoute.times.violation;
+        throw std::runtime_error(message.str());
+    }
+#else
+    (void)route;
+    (void)change;
+    (void)answer;
+    (void)problemInstance;
+    (void)constraints;
+    (void)checkName;
+#endif
+}
+
+// Function to check if the children of loads can be picked up at a stop before position of the route (position 0: the route
+// already visits the stop) without breaking the time constraints. newNodes are the visited nodes after the insertion when it
+// also adds schools, nullptr otherwise. A new stop between two nodes of the route is checked by canInsertStopInTime; the
+// other insertions by a full computeRouteTimes of the changed route, which must not add violation to the route.
+bool isInsertionInTime(Route& route, size_t position, int nodeId, const int* loads, const std::vector<int>* newNodes,
+                       const ProblemInstance& problemInstance, const TimeConstraints& constraints) {
+    auto insert = [&](Route& changedRoute) {
+        if (newNodes != nullptr) {
+            changedRoute.visitedNodes = *newNodes;
+        } else if (position > 0) {
+            changedRoute.visitedNodes.insert(changedRoute.visitedNodes.begin() + position, nodeId);
+        }
+        addPickup(changedRoute, nodeId, loads);
+    };
+
+    if (newNodes == nullptr && position > 0 && position < route.visitedNodes.size()) {
+        bool answer = canInsertStopInTime(route, position, nodeId, problemInstance, constraints, loads);
+        checkTimeAnswer(route, insert, answer, problemInstance, constraints, "canInsertStopInTime");
+        return answer;
+    }
+    updateRouteTimes(route, problemInstance, constraints);
+    Route changedRoute = route;
+    insert(changedRoute);
+    computeRouteTimes(changedRoute, problemInstance, constraints);
+    return changedRoute.times.violation <= route.times.violation + TIME_TOLERANCE;
+}
+
 // Struct to represent an Individual
 struct Individual {
     std::vector<Route> routes; // Vector of routes
@@ -1057,6 +2107,31 @@ struct Individual {
         : routes(routesVec), fitness(fit) {}
 };
 
+// Function to report the drift of the objective when the matrices are stored with a reduced precision:
+// every individual is evaluated with the double baseline and with the reduced matrix.
+// It returns the maximum absolute drift of the fitness.
+double validateMatrixPrecision(const std::vector<Individual>& population, const DistanceMatrix& baselineMatrix, const DistanceMatrix& reducedMatrix) {
+    double maxDrift = 0.0;
+    double maxRelativeDrift = 0.0;
+
+    for (const auto& individual : population) {
+        double baselineFitness = calculateRoutesFitness(individual.routes, baselineMatrix);
+        double reducedFitness = calculateRoutesFitness(individual.routes, reducedMatrix);
+        double drift = std::abs(reducedFitness - baselineFitness);
+        maxDrift = std::max(maxDrift, drift);
+        if (baselineFitness > 0.0) {
+            maxRelativeDrift = std::max(maxRelativeDrift, drift / baselineFitness);
+        }
+    }
+
+    std::cout << "\nPrecision validation (" << matrixPrecisionName(reducedMatrix.getPrecision()) << " against double)" << std::endl;
+    std::cout << "- Individuals evaluated: " << population.size() << std::endl;
+    std::cout << "- Max matrix entry error: " << maxMatrixDifference(baselineMatrix, reducedMatrix) << std::endl;
+    std::cout << "- Max objective drift: " << maxDrift << " (relative " << maxRelativeDrift << ")" << std::endl;
+
+    return maxDrift;
+}
+
 // Struct to represent a Population
 struct Population {
     std::vector<Individual> individuals; // Vector of individuals
@@ -1067,50 +2142,427 @@ struct Population {
         : generationIndex(0) {}
 };
 
-// Function to initialize the population of individuals
+// Procedure used by initializePopulation to build the routes of an individual
+enum class ConstructionStrategy {
+    RandomBusesAndNodes, // buildRoutesRandomBusesAndNodes
+    Savings, // buildRoutesSavings: the plain savings for the first individual, randomized savings for the others
+    Sweep // buildRoutesSweep from a random start angle
+};
+
+// Procedure used by initializePopulation to add the nodes left unserved by the construction
+enum class RepairStrategy {
+    Probability, // addNodesUsingProbabilityAndFindOptimal
+    Cheapest, // insertNodesGreedy, cheapest insertion
+    Regret // insertNodesGreedy, regret-REGRET_K insertion
+};
+
+const int REGRET_K = 3;
+
+// Noise of the savings of the individuals after the first one (ConstructionStrategy::Savings)
+const double SAVINGS_RANDOMIZATION = 0.3;
+
+// Seed of initializePopulation that asks for a seed drawn from std::random_device
+const uint64_t RANDOM_SEED = 0;
+
+// Function to build one individual that serves every node (plainSavings: no noise on the savings)
+Individual buildIndividual(const ProblemInstance& problemInstance, ConstructionStrategy strategy, RouteCostCache* routeCache, bool plainSavings,
+                           RepairStrategy repair = RepairStrategy::Probability, int maxSplitsPerStop = MAX_SPLITS_PER_STOP,
+                           const TimeConstraints* timeConstraints = nullptr) {
+    const int maxAttempts = 100; // Attempts to build an individual that serves every node
+
+    std::vector<Route> routes;
+    for (int attempt = 1; ; ++attempt) {
+        // Build routes and get unserved nodes
+        std::vector<int> unservedNodes;
+        if (strategy == ConstructionStrategy::Savings) {
+            double randomization = (plainSavings && attempt == 1) ? 0.0 : SAVINGS_RANDOMIZATION;
+            std::tie(routes, unservedNodes) = buildRoutesSavings(problemInstance, problemInstance.busCapacities, randomization, routeCache);
+        } else if (strategy == ConstructionStrategy::Sweep) {
+            double startAngle = std::uniform_real_distribution<double>(0.0, 2.0 * PI)(randomEngine());
+            std::tie(routes, unservedNodes) = buildRoutesSweep(problemInstance, problemInstance.busCapacities, startAngle, routeCache);
+        } else {
+            std::tie(routes, unservedNodes) = buildRoutesRandomBusesAndNodes(problemInstance, problemInstance.busCapacities, maxSplitsPerStop);
+        }
+
+        // Add unserved nodes to routes using provided procedure; if some node does not fit, the individual is built again
+        std::vector<int> unplacedNodes;
+        if (repair == RepairStrategy::Probability) {
+            unplacedNodes = addNodesUsingProbabilityAndFindOptimal(
+                routes,
+                unservedNodes,
+                problemInstance,
+                problemInstance.getBusesCapacity(),
+                findAllClusterIDs(problemInstance),
+                problemInstance.getDistancesMatrix(),
+                routeCache,
+                maxSplitsPerStop
+            );
+        } else {
+            unplacedNodes = insertNodesGreedy(routes, unservedNodes, problemInstance, problemInstance.getBusesCapacity(),
+                                              problemInstance.getDistancesMatrix(), repair == RepairStrategy::Regret ? REGRET_K : 1,
+                                              maxSplitsPerStop, timeConstraints);
+        }
+        if (unplacedNodes.empty()) {
+            break;
+        }
+        if (attempt == maxAttempts) {
+            throw std::runtime_error("Cannot build an individual that serves every node in " + std::to_string(maxAttempts) + " attempts");
+        }
+    }
+
+    // The fitness of the individual is the sum of the cached costs of its routes
+    double fitness = sumRouteCosts(routes);
+    return Individual(routes, fitness);
+}
+
+// Function to initialize the population of individuals (the orderings of the routes are shared through routeCache, if given).
+// The individuals are built by numThreads workers into preallocated slots: worker t builds one contiguous block of the
+// population with its own random stream, seeded from (seed, t). For a given seed and number of threads the population
+// is always the same; with RANDOM_SEED the seed is drawn from std::random_device. A bus stop is split among maxSplitsPerStop routes at most.
+// With timeConstraints the greedy repairs (RepairStrategy::Cheapest and Regret) insert the stops where they keep the time constraints.
 std::vector<Individual> initializePopulation(
     const ProblemInstance& problemInstance,
-    int populationSize) 
+    int populationSize,
+    ConstructionStrategy strategy = ConstructionStrategy::RandomBusesAndNodes,
+    RouteCostCache* routeCache = nullptr,
+    unsigned numThreads = 1,
+    uint64_t seed = RANDOM_SEED,
+    RepairStrategy repair = RepairStrategy::Probability,
+    int maxSplitsPerStop = MAX_SPLITS_PER_STOP,
+    const TimeConstraints* timeConstraints = nullptr)
 {
-    std::vector<Individual> population;
-    
-    for (int i = 0; i < populationSize; ++i) {
-        // Build routes and get unserved nodes
-        auto [routes, unservedNodes] = buildRoutesRandomBusesAndNodes(problemInstance, problemInstance.busCapacities);
+    if (populationSize <= 0) {
+        return {};
+    }
+    std::vector<Individual> population(populationSize, Individual({}, 0.0));
+
+    // The components used by the construction are loaded here, not by the workers
+    problemInstance.getDistancesMatrix();
+    findAllClusterIDs(problemInstance);
+    if (timeConstraints != nullptr) {
+        problemInstance.getTimesMatrix();
+    }
 
-        // Add unserved nodes to routes using provided procedure
-        addNodesUsingProbabilityAndFindOptimal(
-            routes,
-            unservedNodes,
-            problemInstance.getNodesMatrix(),
-            problemInstance.getBusesCapacity(),
-            findAllClusterIDs(problemInstance.getNodesMatrix()),
-            problemInstance.getDistancesMatrix()
-        );
+    if (seed == RANDOM_SEED) {
+        seed = (static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}();
+    }
+    numThreads = std::max(1u, std::min<unsigned>(numThreads, populationSize));
 
-        // Calculate fitness for the individual (this assumes yous have a function to calculate fitness)
-        double fitness = calculateRoutesFitness(routes, problemInstance.getDistancesMatrix()); // You need to define calculateFitness function
+    std::vector<std::exception_ptr> errors(numThreads);
+    auto worker = [&](unsigned t) {
+        try {
+            std::seed_seq streamSeed{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), t };
+            std::vector<uint32_t> engineSeed(1);
+            streamSeed.generate(engineSeed.begin(), engineSeed.end());
+            seedRandomEngine(engineSeed[0]);
 
-        // Create an individual with the generated routes and calculated fitness
-        Individual individual(routes, fitness);
+            size_t first = static_cast<size_t>(populationSize) * t / numThreads;
+            size_t last = static_cast<size_t>(populationSize) * (t + 1) / numThreads;
+            for (size_t i = first; i < last; ++i) {
+                population[i] = buildIndividual(problemInstance, strategy, routeCache, i == 0, repair, maxSplitsPerStop, timeConstraints);
+            }
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
 
-        // Add the individual to the population
-        population.push_back(individual);
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker, t);
     }
-    
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
     return population;
 }
 
+// ----------------- Batch evaluation -----------------
+
+// All the routes of a population in one flat encoding: the visited nodes of every route one after the other.
+// Route r is nodes[routeOffsets[r] .. routeOffsets[r + 1]) and the routes of individual i are
+// routeOffsets[individualOffsets[i] .. individualOffsets[i + 1]).
+struct FlatRoutes {
+    std::vector<int32_t> nodes;
+    std::vector<uint32_t> routeOffsets;
+    std::vector<uint32_t> individualOffsets;
+    std::vector<double> arcCosts; // Buffer of the kernel: cost of the arc from nodes[k] to nodes[k + 1]
+};
+
+// Function to write the routes of a population in the flat encoding
+FlatRoutes flattenPopulation(const std::vector<Individual>& population) {
+    FlatRoutes flat;
+    flat.routeOffsets.push_back(0);
+    flat.individualOffsets.push_back(0);
+    for (const Individual& individual : population) {
+        for (const Route& route : individual.routes) {
+            flat.nodes.insert(flat.nodes.end(), route.visitedNodes.begin(), route.visitedNodes.end());
+            flat.routeOffsets.push_back(static_cast<uint32_t>(flat.nodes.size()));
+        }
+        flat.individualOffsets.push_back(static_cast<uint32_t>(flat.routeOffsets.size() - 1));
+    }
+    return flat;
+}
+
+// Function to calculate the cost of every route and the fitness of every individual of a flat population.
+// The cost of all the arcs is read in one pass of DistanceMatrix::gatherArcs (the arcs between the last node of a
+// route and the first node of the next one are read too, and ignored), then the arcs of each route are summed in order,
+// so the results are the same of calculateRouteFitness and calculateRoutesFitness.
+void evaluateFlatRoutes(FlatRoutes& flat, const DistanceMatrix& distanceMatrix, std::vector<double>& routeCosts, std::vector<double>& fitnesses) {
+    size_t numArcs = flat.nodes.empty() ? 0 : flat.nodes.size() - 1;
+    flat.arcCosts.resize(numArcs);
+    distanceMatrix.gatherArcs(flat.nodes.data(), flat.nodes.data() + 1, numArcs, flat.arcCosts.data());
+
+    size_t numRoutes = flat.routeOffsets.size() - 1;
+    routeCosts.assign(numRoutes, 0.0);
+    for (size_t r = 0; r < numRoutes; ++r) {
+        double cost = 0.0;
+        for (uint32_t k = flat.routeOffsets[r]; k + 1 < flat.routeOffsets[r + 1]; ++k) {
+            cost += flat.arcCosts[k];
+        }
+        routeCosts[r] = cost;
+    }
+
+    size_t numIndividuals = flat.individualOffsets.size() - 1;
+    fitnesses.assign(numIndividuals, 0.0);
+    for (size_t i = 0; i < numIndividuals; ++i) {
+        for (uint32_t r = flat.individualOffsets[i]; r < flat.individualOffsets[i + 1]; ++r) {
+            fitnesses[i] += routeCosts[r];
+        }
+    }
+}
+
+// Function to evaluate a whole population with the batch kernel: it sets the cost of every route and the fitness of every individual
+void evaluatePopulation(std::vector<Individual>& population, const DistanceMatrix& distanceMatrix) {
+    FlatRoutes flat = flattenPopulation(population);
+    std::vector<double> routeCosts, fitnesses;
+    evaluateFlatRoutes(flat, distanceMatrix, routeCosts, fitnesses);
+
+    size_t r = 0;
+    for (size_t i = 0; i < population.size(); ++i) {
+        for (Route& route : population[i].routes) {
+            route.cost = routeCosts[r++];
+        }
+        population[i].fitness = fitnesses[i];
+    }
+}
+
+// Function to compare the throughput (arcs per second) of the batch kernel against calculateRoutesFitness on a population.
+// It returns the largest difference between the two fitness values of an individual (it must be 0).
+double benchmarkBatchEvaluation(const std::vector<Individual>& population, const DistanceMatrix& distanceMatrix, int repetitions) {
+    FlatRoutes flat = flattenPopulation(population);
+    size_t numArcs = flat.nodes.size() - (flat.routeOffsets.size() - 1);
+    std::vector<double> routeCosts, fitnesses;
+    std::vector<double> scalarFitnesses(population.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; ++rep) {
+        for (size_t i = 0; i < population.size(); ++i) {
+            scalarFitnesses[i] = calculateRoutesFitness(population[i].routes, distanceMatrix);
+        }
+    }
+    double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; ++rep) {
+        evaluateFlatRoutes(flat, distanceMatrix, routeCosts, fitnesses);
+    }
+    double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < population.size(); ++i) {
+        maxDifference = std::max(maxDifference, std::abs(fitnesses[i] - scalarFitnesses[i]));
+    }
+
+    double totalArcs = static_cast<double>(numArcs) * repetitions;
+    std::cout << "\nBatch evaluation (" << DistanceMatrix::gatherKernelName() << " kernel, " << matrixPrecisionName(distanceMatrix.getPrecision()) << " matrix)" << std::endl;
+    std::cout << "- Individuals: " << population.size() << ", routes: " << flat.routeOffsets.size() - 1
+              << ", arcs: " << numArcs << ", repetitions: " << repetitions << std::endl;
+    std::cout << "- calculateRoutesFitness: " << totalArcs / scalarSeconds << " arcs/s" << std::endl;
+    std::cout << "- Batch kernel: " << totalArcs / batchSeconds << " arcs/s (speedup " << scalarSeconds / batchSeconds << "x)" << std::endl;
+    std::cout << "- Max fitness difference: " << maxDifference << std::endl;
+
+    return maxDifference;
+}
+
 
 
 // ----------------- EA OPERATORS -----------------
 
+// The operators update individual.fitness by the change of the arcs they touch, instead of
+// computing the distance of every route again. Compile with -DDEBUG_DELTA_EVALUATION to
+// check every update against a full recompute.
+// two_opt, shift and bind_nnn only reorder the nodes of a route, so the pickups of a split bus stop stay valid;
+// move_partial_load moves children of a stop between two routes.
+
+// Function to swap the nodes at positions i and j of a route and return the change of its distance
+// Only the arcs entering and leaving the two positions change (at most four arcs)
+double swapNodesWithDelta(std::vector<int>& visitedNodes, size_t i, size_t j, const DistanceMatrix& distanceMatrix) {
+    if (i == j) {
+        return 0.0;
+    }
+
+    // Arcs starting at these positions (an arc is shared when i and j are adjacent)
+    size_t arcs[4];
+    size_t numArcs = 0;
+    auto addArc = [&](size_t start) {
+        if (start + 1 < visitedNodes.size() && std::find(arcs, arcs + numArcs, start) == arcs + numArcs) {
+            arcs[numArcs++] = start;
+        }
+    };
+    for (size_t position : {i, j}) {
+        if (position > 0) {
+            addArc(position - 1);
+        }
+        addArc(position);
+    }
+
+    double delta = 0.0;
+    for (size_t a = 0; a < numArcs; ++a) {
+        delta -= distanceMatrix.at(visitedNodes[arcs[a]], visitedNodes[arcs[a] + 1]);
+    }
+    std::swap(visitedNodes[i], visitedNodes[j]);
+    for (size_t a = 0; a < numArcs; ++a) {
+        delta += distanceMatrix.at(visitedNodes[arcs[a]], visitedNodes[arcs[a] + 1]);
+    }
+
+    return delta;
+}
+
+// Function to get the change of the route distance if the nodes at positions first..last are rotated
+// right by shiftAmount (the node at position i goes to first + (i - first + shiftAmount) % length).
+// The inner arcs keep their direction, so only the three arcs at the boundaries change.
+double rotateSegmentDelta(const std::vector<int>& visitedNodes, size_t first, size_t last, size_t shiftAmount, const DistanceMatrix& distanceMatrix) {
+    size_t length = last - first + 1;
+    shiftAmount %= length;
+    if (shiftAmount == 0) {
+        return 0.0;
+    }
+
+    // The segment becomes visitedNodes[split + 1 .. last] followed by visitedNodes[first .. split]
+    size_t split = last - shiftAmount;
+    double delta = distanceMatrix.at(visitedNodes[last], visitedNodes[first])
+                 - distanceMatrix.at(visitedNodes[split], visitedNodes[split + 1]);
+    if (first > 0) {
+        delta += distanceMatrix.at(visitedNodes[first - 1], visitedNodes[split + 1])
+               - distanceMatrix.at(visitedNodes[first - 1], visitedNodes[first]);
+    }
+    if (last + 1 < visitedNodes.size()) {
+        delta += distanceMatrix.at(visitedNodes[split], visitedNodes[last + 1])
+               - distanceMatrix.at(visitedNodes[last], visitedNodes[last + 1]);
+    }
+
+    return delta;
+}
+
+// Function to get the change of the route distance if consecutive blocks of nodes are put in a new order.
+// Block k is visitedNodes[blockBegin[k] .. blockBegin[k + 1] - 1] (blockBegin has one entry more than the
+// blocks), and order[k] is the block placed k-th. The blocks are not reversed, so only the arcs between
+// the blocks and at the two ends change.
+double permuteBlocksDelta(const std::vector<int>& visitedNodes, const std::vector<size_t>& blockBegin, const std::vector<int>& order, const DistanceMatrix& distanceMatrix) {
+    const size_t numBlocks = order.size();
+    const size_t first = blockBegin.front();
+    const size_t end = blockBegin.back();
+    if (first == end) {
+        return 0.0;
+    }
+
+    double delta = 0.0;
+
+    // Arcs removed: the ones entering each non empty block and the one leaving the last node
+    for (size_t k = 0; k < numBlocks; ++k) {
+        size_t begin = blockBegin[k];
+        if (begin < blockBegin[k + 1] && begin > 0) {
+            delta -= distanceMatrix.at(visitedNodes[begin - 1], visitedNodes[begin]);
+        }
+    }
+    if (end < visitedNodes.size()) {
+        delta -= distanceMatrix.at(visitedNodes[end - 1], visitedNodes[end]);
+    }
+
+    // Arcs added: from the node before the blocks through the blocks in the new order to the node after them
+    int previousNode = (first > 0) ? visitedNodes[first - 1] : -1;
+    for (int block : order) {
+        size_t begin = blockBegin[block];
+        size_t blockEnd = blockBegin[block + 1];
+        if (begin == blockEnd) {
+            continue;
+        }
+        if (previousNode != -1) {
+            delta += distanceMatrix.at(previousNode, visitedNodes[begin]);
+        }
+        previousNode = visitedNodes[blockEnd - 1];
+    }
+    if (end < visitedNodes.size()) {
+        delta += distanceMatrix.at(previousNode, visitedNodes[end]);
+    }
+
+    return delta;
+}
+
+// Function to check if the positions are consecutive in the route (the kernels above need it)
+bool areConsecutivePositions(const std::vector<int>& positions) {
+    return positions.empty() || static_cast<size_t>(positions.back() - positions.front()) == positions.size() - 1;
+}
+
+// Function to check the fitness and the cached route costs updated by an operator against a full recompute
+// (only with DEBUG_DELTA_EVALUATION)
+void checkFitnessDelta(const Individual& individual, const DistanceMatrix& distanceMatrix, const char* operatorName) {
+#ifdef DEBUG_DELTA_EVALUATION
+    auto differs = [](double updated, double recomputed) {
+        return std::abs(recomputed - updated) > 1e-6 * std::max(1.0, std::abs(recomputed));
+    };
+    double recomputed = calculateRoutesFitness(individual.routes, distanceMatrix);
+    if (differs(individual.fitness, recomputed)) {
+        std::ostringstream message;
+        message << std::setprecision(17) << operatorName << ": fitness updated to " << individual.fitness
+                << " but the routes give " << recomputed;
+        throw std::runtime_error(message.str());
+    }
+    for (const Route& route : individual.routes) {
+        double routeCost = calculateRouteFitness(route, distanceMatrix);
+        if (differs(route.cost, routeCost) || route.load != totalSchoolLoad(route.childrenToCluster.data(), route.numSchools)) {
+            std::ostringstream message;
+            message << std::setprecision(17) << operatorName << ": bus " << route.busIndex << " has cached cost " << route.cost
+                    << " and load " << route.load << ", but its nodes give " << routeCost;
+            throw std::runtime_error(message.str());
+        }
+
+        // The pickups add up to childrenToCluster and every stop with a pickup is visited
+        SchoolLoads pickups{};
+        for (size_t e = 0; e < route.pickupStops.size(); ++e) {
+            addSchoolLoads(pickups.data(), getPickupLoads(route, static_cast<int>(e)), route.numSchools);
+            if (std::find(route.visitedNodes.begin(), route.visitedNodes.end(), route.pickupStops[e]) == route.visitedNodes.end()) {
+                throw std::runtime_error(std::string(operatorName) + ": bus " + std::to_string(route.busIndex) + " picks up children at node "
+                                         + std::to_string(route.pickupStops[e]) + " without visiting it");
+            }
+        }
+        if (!std::equal(pickups.begin(), pickups.begin() + route.numSchools, route.childrenToCluster.begin())) {
+            throw std::runtime_error(std::string(operatorName) + ": the pickups of bus " + std::to_string(route.busIndex)
+                                     + " do not add up to its children to clusters");
+        }
+    }
+#else
+    (void)individual;
+    (void)distanceMatrix;
+    (void)operatorName;
+#endif
+}
+
 
 
 
 // Function to perform a single swap between two nodes that are neither 0 nor cluster nodes on a random route
 // If the number of cluster nodes is greater than 1, there's a low probability of swapping two cluster nodes instead
-void two_opt(Individual &individual, const std::vector<int> &clusterNodes, const std::vector<std::vector<double>> &distanceMatrix) {
+// With problemInstance and timeConstraints, a swap that breaks the time constraints is not made (canSwapStopsInTime for two bus stops)
+void two_opt(Individual &individual, const std::vector<int> &clusterNodes, const DistanceMatrix &distanceMatrix,
+             const ProblemInstance* problemInstance = nullptr, const TimeConstraints* timeConstraints = nullptr) {
     // Check if there are any routes in the individual
     if (individual.routes.empty()) {
         return;
@@ -1149,28 +2601,54 @@ void two_opt(Individual &individual, const std::vector<int> &clusterNodes, const
     bool swapClusters = 
         (validNodeIndices.size() > 1) && (std::rand() % 100 < 10) && (clusterNodeIndices.size() > 1) || validNodeIndices.size() < 2 && clusterNodeIndices.size() >= 2;
 
+    const std::vector<int>* swapIndices = nullptr;
     if (swapClusters) {
         // Swap two cluster nodes
-        int idx1 = std::rand() % clusterNodeIndices.size();
-        int idx2 = idx1;
-        while (idx2 == idx1) {
-            idx2 = std::rand() % clusterNodeIndices.size();
-        }
-        std::swap(route.visitedNodes[clusterNodeIndices[idx1]], route.visitedNodes[clusterNodeIndices[idx2]]);
+        swapIndices = &clusterNodeIndices;
     } else if (validNodeIndices.size() >= 2) {
         // Swap two bus stop nodes
-        int idx1 = std::rand() % validNodeIndices.size();
+        swapIndices = &validNodeIndices;
+    }
+
+    double delta = 0.0;
+    if (swapIndices != nullptr) {
+        int idx1 = std::rand() % swapIndices->size();
         int idx2 = idx1;
         while (idx2 == idx1) {
-            idx2 = std::rand() % validNodeIndices.size();
+            idx2 = std::rand() % swapIndices->size();
+        }
+        size_t i = (*swapIndices)[idx1];
+        size_t j = (*swapIndices)[idx2];
+
+        // With the time constraints: two stops before the first school are checked in constant time, the other swaps
+        // by computing the times of the swapped route (the swap must not add violation)
+        bool inTime = true;
+        if (problemInstance != nullptr && timeConstraints != nullptr) {
+            auto swap = [&](Route& changedRoute) { std::swap(changedRoute.visitedNodes[i], changedRoute.visitedNodes[j]); };
+            size_t firstSchool = findFirstSchoolPosition(route, *problemInstance);
+            if (!swapClusters && std::max(i, j) < firstSchool && firstSchool < route.visitedNodes.size()) {
+                inTime = canSwapStopsInTime(route, i, j, *problemInstance, *timeConstraints);
+                checkTimeAnswer(route, swap, inTime, *problemInstance, *timeConstraints, "canSwapStopsInTime");
+            } else {
+                updateRouteTimes(route, *problemInstance, *timeConstraints);
+                Route changedRoute = route;
+                swap(changedRoute);
+                computeRouteTimes(changedRoute, *problemInstance, *timeConstraints);
+                inTime = changedRoute.times.violation <= route.times.violation + TIME_TOLERANCE;
+            }
+        }
+        if (inTime) {
+            delta = swapNodesWithDelta(route.visitedNodes, i, j, distanceMatrix);
+        } else {
+            std::cout << "\nSwap of positions " << i << " and " << j << " skipped: it breaks the time constraints" << std::endl;
         }
-        std::swap(route.visitedNodes[validNodeIndices[idx1]], route.visitedNodes[validNodeIndices[idx2]]);
     }
 
-    // Update the fitness 
-    double newFitness = calculateRoutesFitness(individual.routes, distanceMatrix);
-    
-    individual.fitness = newFitness;
+    // Update the cost of the route and the fitness with the change of the swapped arcs
+    route.cost += delta;
+    route.times.valid = false;
+    individual.fitness += delta;
+    checkFitnessDelta(individual, distanceMatrix, "two_opt");
 
     // Print the route after swapping AND the fitness of the individual after swapping 
     std::cout << "\nRoute after swapping:\n";
@@ -1182,45 +2660,57 @@ void two_opt(Individual &individual, const std::vector<int> &clusterNodes, const
 
 // Shift operator function
 
-void performShiftOnArray(std::vector<int> &arr) {
-    if (arr.size() < 2) {
-        return; // Not enough elements to perform a shift
+// A shift: the stretch arr[startIndex .. startIndex + stretchLength - 1] is rotated right by shiftAmount
+// (stretchLength is 0 when no shift was possible)
+struct ShiftMove {
+    int startIndex;
+    int stretchLength;
+    int shiftAmount;
+};
+
+// Function to pick a random shift of an array of the given size
+ShiftMove randomShiftMove(size_t size) {
+    ShiftMove move = {0, 0, 0};
+    if (size < 2) {
+        return move; // Not enough elements to perform a shift
     }
 
     // Select a random start index for the stretch
-    int startIndex = std::rand() % (arr.size() - 1);
+    int startIndex = std::rand() % (size - 1);
 
     // Ensure the stretch length is at least 2 to perform the shift
-    int maxStretchLength = arr.size() - startIndex;
+    int maxStretchLength = size - startIndex;
     if (maxStretchLength < 2) {
-        return;
+        return move;
     }
 
     int stretchLength = std::rand() % maxStretchLength + 1;
     if (stretchLength < 2) {
-        return;
-    }
-
-    std::vector<int> stretchIndices;
-    for (int i = 0; i < stretchLength; ++i) {
-        stretchIndices.push_back((startIndex + i) % arr.size());
+        return move;
     }
 
     // Determine the shift amount
-    int shiftAmount = std::rand() % (stretchLength - 1) + 1;
+    move.startIndex = startIndex;
+    move.stretchLength = stretchLength;
+    move.shiftAmount = std::rand() % (stretchLength - 1) + 1;
+    return move;
+}
 
-    // Shift the stretch
-    std::vector<int> tempStretch(stretchLength);
-    for (int i = 0; i < stretchLength; ++i) {
-        tempStretch[(i + shiftAmount) % stretchLength] = arr[stretchIndices[i]];
+// Function to apply a shift to an array
+void applyShiftMove(std::vector<int> &arr, const ShiftMove& move) {
+    if (move.stretchLength < 2) {
+        return;
     }
+    auto stretchBegin = arr.begin() + move.startIndex;
+    auto stretchEnd = stretchBegin + move.stretchLength;
+    std::rotate(stretchBegin, stretchEnd - move.shiftAmount, stretchEnd);
+}
 
-    for (int i = 0; i < stretchLength; ++i) {
-        arr[stretchIndices[i]] = tempStretch[i];
-    }
+void performShiftOnArray(std::vector<int> &arr) {
+    applyShiftMove(arr, randomShiftMove(arr.size()));
 }
 
-void shift(Individual &individual, const std::vector<int> &clusterNodes, const std::vector<std::vector<double>> &distanceMatrix) {
+void shift(Individual &individual, const std::vector<int> &clusterNodes, const DistanceMatrix &distanceMatrix) {
     if (individual.routes.empty()) {
         return;
     }
@@ -1258,16 +2748,34 @@ void shift(Individual &individual, const std::vector<int> &clusterNodes, const s
     }
 
     // Perform the shift operation on the valid nodes array
-    performShiftOnArray(validNodes);
+    ShiftMove move = randomShiftMove(validNodes.size());
+    applyShiftMove(validNodes, move);
+
+    // Change of the distance: from the boundary arcs when the stops are consecutive in the route,
+    // otherwise from the distance of this route only
+    double delta = 0.0;
+    bool consecutive = areConsecutivePositions(validNodeIndices);
+    if (!consecutive) {
+        delta -= calculateRouteFitness(route, distanceMatrix);
+    } else if (move.stretchLength >= 2) {
+        size_t first = validNodeIndices[move.startIndex];
+        delta = rotateSegmentDelta(route.visitedNodes, first, first + move.stretchLength - 1, move.shiftAmount, distanceMatrix);
+    }
 
     // Place the shifted valid nodes back into the original route
     for (size_t i = 0; i < validNodeIndices.size(); ++i) {
         route.visitedNodes[validNodeIndices[i]] = validNodes[i];
     }
 
-    // Update the fitness
-    double newFitness = calculateRoutesFitness(individual.routes, distanceMatrix);
-    individual.fitness = newFitness;
+    if (!consecutive) {
+        delta += calculateRouteFitness(route, distanceMatrix);
+    }
+
+    // Update the cost of the route and the fitness
+    route.cost += delta;
+    route.times.valid = false;
+    individual.fitness += delta;
+    checkFitnessDelta(individual, distanceMatrix, "shift");
 
     // Print the route after shifting and the fitness of the individual after shifting
     std::cout << "\nRoute after shifting:\n";
@@ -1277,7 +2785,7 @@ void shift(Individual &individual, const std::vector<int> &clusterNodes, const s
 }
 
 
-void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, const std::vector<std::vector<double>> &distanceMatrix) {
+void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, const DistanceMatrix &distanceMatrix) {
     if (individual.routes.empty()) {
         return;
     }
@@ -1324,6 +2832,21 @@ void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, cons
     std::vector<int> partOrder = {0, 1, 2, 3};
     std::random_shuffle(partOrder.begin(), partOrder.end());
 
+    // Change of the distance: from the arcs between the parts when the stops are consecutive in the route,
+    // otherwise from the distance of this route only
+    double delta = 0.0;
+    bool consecutive = areConsecutivePositions(validNodeIndices);
+    if (consecutive) {
+        std::vector<size_t> partBegin(5);
+        partBegin[0] = validNodeIndices.front();
+        for (int i = 0; i < 4; ++i) {
+            partBegin[i + 1] = partBegin[i] + parts[i].size();
+        }
+        delta = permuteBlocksDelta(route.visitedNodes, partBegin, partOrder, distanceMatrix);
+    } else {
+        delta -= calculateRouteFitness(route, distanceMatrix);
+    }
+
     // Apply the permutation to the route
     currentIndex = 0;
     for (int i : partOrder) {
@@ -1333,9 +2856,15 @@ void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, cons
         }
     }
 
-    // Update the fitness
-    double newFitness = calculateRoutesFitness(individual.routes, distanceMatrix);
-    individual.fitness = newFitness;
+    if (!consecutive) {
+        delta += calculateRouteFitness(route, distanceMatrix);
+    }
+
+    // Update the cost of the route and the fitness
+    route.cost += delta;
+    route.times.valid = false;
+    individual.fitness += delta;
+    checkFitnessDelta(individual, distanceMatrix, "bind_nnn");
 
     // Print the route after permutation and the fitness of the individual after permutation
     std::cout << "\nRoute after permutation:\n";
@@ -1344,6 +2873,82 @@ void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, cons
 }
 
 
+// Function to move part of the children of a bus stop from a random route to another random route with room for them
+// (split delivery): the target route adds the stop if it does not visit it yet, unless the stop already has maxSplitsPerStop
+// routes, and the source route drops the stop when none of its children are left. Both routes are ordered again with
+// findOptimalRoute and the fitness is updated by the change of their costs. The draws come from randomEngine,
+// so the move is reproducible for a given seed
+void move_partial_load(Individual &individual, const ProblemInstance &problemInstance, const std::vector<int> &busesCapacities,
+                       int maxSplitsPerStop = MAX_SPLITS_PER_STOP) {
+    if (individual.routes.size() < 2) {
+        return;
+    }
+    const DistanceMatrix& distanceMatrix = problemInstance.getDistancesMatrix();
+    const std::vector<int>& clusterIDs = findAllClusterIDs(problemInstance);
+    std::vector<Route>& routes = individual.routes;
+    std::mt19937& gen = randomEngine();
+    auto draw = [&gen](int first, int last) { return std::uniform_int_distribution<>(first, last)(gen); };
+
+    // Select a random route and one of its bus stops
+    int sourceIndex = draw(0, routes.size() - 1);
+    Route &source = routes[sourceIndex];
+    if (source.pickupStops.empty()) {
+        return;
+    }
+    int e = draw(0, source.pickupStops.size() - 1);
+    int busStop = source.pickupStops[e];
+
+    // Routes that can take children of the stop
+    bool newSplit = countServingRoutes(routes, busStop) < maxSplitsPerStop;
+    std::vector<int> targets;
+    for (size_t r = 0; r < routes.size(); ++r) {
+        if (static_cast<int>(r) != sourceIndex && routes[r].load < busesCapacities[routes[r].busIndex - 1] &&
+            (newSplit || findPickup(routes[r], busStop) != -1)) {
+            targets.push_back(static_cast<int>(r));
+        }
+    }
+    if (targets.empty()) {
+        return; // No route can take children of this bus stop
+    }
+    Route &target = routes[targets[draw(0, targets.size() - 1)]];
+
+    // Children to move: a random amount, from the first schools of the pickup
+    int room = busesCapacities[target.busIndex - 1] - target.load;
+    std::vector<int> remaining(getPickupLoads(source, e), getPickupLoads(source, e) + source.numSchools);
+    int amount = draw(1, std::min(totalSchoolLoad(remaining.data(), source.numSchools), room));
+    SchoolLoads moved;
+    takeChildren(remaining.data(), source.numSchools, amount, moved);
+
+    // Print the routes before the move and the fitness of the individual before the move
+    std::cout << "\nRoutes before moving " << amount << " children of node " << busStop << ":\n";
+    printRoute(source);
+    printRoute(target);
+    std::cout << "\nFitness before moving: " << individual.fitness << std::endl;
+
+    // The source route drops the stop if no children are left there, and the schools that only the moved children needed
+    double before = source.cost + target.cost;
+    if (removePickup(source, e, moved.data())) {
+        source.visitedNodes.erase(std::remove(source.visitedNodes.begin(), source.visitedNodes.end(), busStop), source.visitedNodes.end());
+    }
+    removeUnusedSchools(source, problemInstance);
+    if (source.visitedNodes.size() > 1) {
+        findOptimalRoute(source, clusterIDs, distanceMatrix);
+    }
+    addNodeToRoute(target, busStop, problemInstance, moved.data());
+    findOptimalRoute(target, clusterIDs, distanceMatrix);
+
+    // Update the fitness with the change of the two routes
+    individual.fitness += source.cost + target.cost - before;
+    checkFitnessDelta(individual, distanceMatrix, "move_partial_load");
+
+    // Print the routes after the move and the fitness of the individual after the move
+    std::cout << "\nRoutes after moving:\n";
+    printRoute(source);
+    printRoute(target);
+    std::cout << "Fitness after moving: " << individual.fitness << std::endl;
+}
+
+
 
 
 
@@ -1351,7 +2956,7 @@ void bind_nnn(Individual &individual, const std::vector<int> &clusterNodes, cons
 // ----------------- MAIN -----------------
 
 
-int main() {
+int main(int argc, char* argv[]) {
     // Seed the random number generator once at the beginning of the program
     std::srand(static_cast<unsigned>(std::time(nullptr)));
 
@@ -1370,7 +2975,201 @@ int main() {
     std::string nodesMatrixFile = "buttrio_nodes.csv";
     std::string edgesMatrixFile = "buttrio_edges.csv";
     
-    ProblemInstance problemInstance(folderPath, distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile, numberOfBuses, busesCapacities);
+    // Command line: [instance file] [--precision=double|float|fixed] [--validate-precision] [--no-cache]
+    //               [--alpha=a] [--max-ride=seconds] [--deadline=seconds] [--benchmark-batch] [--route-cache]
+    //               [--construction=random|savings|sweep] [--compare-construction] [--threads=n] [--seed=s] [--benchmark-init]
+    //               [--repair=probability|cheapest|regret] [--max-splits=n]
+    // The compiled binary instance is used if given (e.g. ./ea_operators4 BUTTRIO/buttrio.sbrp), otherwise the CSV files
+    // are loaded through the instance cache (they are parsed only when they change), or parsed directly with --no-cache
+    std::string instanceFile;
+    MatrixPrecision precision = MatrixPrecision::Double;
+    bool validatePrecision = false;
+    bool useCache = true;
+    TimeConstraints timeConstraints;
+    bool timeAware = false;
+    bool benchmarkBatch = false;
+    bool routeCacheReport = false;
+    ConstructionStrategy strategy = ConstructionStrategy::RandomBusesAndNodes;
+    bool compareConstruction = false;
+    unsigned numThreads = 1;
+    uint64_t seed = RANDOM_SEED;
+    bool benchmarkInit = false;
+    RepairStrategy repair = RepairStrategy::Probability;
+    int maxSplitsPerStop = MAX_SPLITS_PER_STOP;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--precision=double") {
+            precision = MatrixPrecision::Double;
+        } else if (arg == "--precision=float") {
+            precision = MatrixPrecision::Float;
+        } else if (arg == "--precision=fixed") {
+            precision = MatrixPrecision::FixedPoint;
+        } else if (arg == "--validate-precision") {
+            validatePrecision = true;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--benchmark-batch") {
+            benchmarkBatch = true;
+        } else if (arg == "--route-cache") {
+            routeCacheReport = true;
+        } else if (arg == "--construction=random") {
+            strategy = ConstructionStrategy::RandomBusesAndNodes;
+        } else if (arg == "--construction=savings") {
+            strategy = ConstructionStrategy::Savings;
+        } else if (arg == "--construction=sweep") {
+            strategy = ConstructionStrategy::Sweep;
+        } else if (arg == "--compare-construction") {
+            compareConstruction = true;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            numThreads = static_cast<unsigned>(std::stoul(arg.substr(10)));
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            seed = std::stoull(arg.substr(7));
+        } else if (arg == "--benchmark-init") {
+            benchmarkInit = true;
+        } else if (arg == "--repair=probability") {
+            repair = RepairStrategy::Probability;
+        } else if (arg == "--repair=cheapest") {
+            repair = RepairStrategy::Cheapest;
+        } else if (arg == "--repair=regret") {
+            repair = RepairStrategy::Regret;
+        } else if (arg.rfind("--max-splits=", 0) == 0) {
+            maxSplitsPerStop = std::max(1, std::stoi(arg.substr(13)));
+        } else if (arg.rfind("--alpha=", 0) == 0) {
+            timeConstraints.alpha = std::stod(arg.substr(8));
+            timeAware = true;
+        } else if (arg.rfind("--max-ride=", 0) == 0) {
+            timeConstraints.maxRideTime = std::stod(arg.substr(11));
+            timeAware = true;
+        } else if (arg.rfind("--deadline=", 0) == 0) {
+            timeConstraints.schoolDeadline = std::stod(arg.substr(11));
+            timeAware = true;
+        } else {
+            instanceFile = arg;
+        }
+    }
+
+    if (instanceFile.empty() && useCache) {
+        instanceFile = cachedInstanceFile(folderPath, distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile);
+        std::cout << "Instance cache: " << instanceFile << std::endl;
+    }
+
+    // The EA only uses the distances: the times and the edges are loaded only if something asks for them
+    auto loadInstance = [&](MatrixPrecision matrixPrecision) {
+        return instanceFile.empty()
+            ? ProblemInstance(folderPath, distanceMatrixFile, timeMatrixFile, nodesMatrixFile, edgesMatrixFile, numberOfBuses, busesCapacities, matrixPrecision, LOAD_DISTANCES)
+            : ProblemInstance(instanceFile, numberOfBuses, busesCapacities, matrixPrecision, LOAD_DISTANCES);
+    };
+
+    ProblemInstance problemInstance = loadInstance(precision);
+    std::cout << "Distance matrix stored as " << matrixPrecisionName(precision) << " ("
+              << problemInstance.getDistancesMatrix().bytes() << " bytes)" << std::endl;
+
+    // Validation mode: compare the objective with the reduced precision against the double baseline
+    if (validatePrecision) {
+        ProblemInstance baselineInstance = loadInstance(MatrixPrecision::Double);
+        std::vector<Individual> population = initializePopulation(baselineInstance, 20, strategy, nullptr, numThreads, seed, repair, maxSplitsPerStop);
+        validateMatrixPrecision(population, baselineInstance.getDistancesMatrix(), problemInstance.getDistancesMatrix());
+        return 0;
+    }
+
+    // Benchmark of the batch evaluation of a population against the route by route evaluation
+    if (benchmarkBatch) {
+        std::vector<Individual> population = initializePopulation(problemInstance, 50, strategy, nullptr, numThreads, seed, repair, maxSplitsPerStop);
+        double maxDifference = benchmarkBatchEvaluation(population, problemInstance.getDistancesMatrix(), 10000);
+        return maxDifference == 0.0 ? 0 : 1;
+    }
+
+    // Wall-clock time of the initialization of a population with 1, 2, 4, ... threads, and check that a seed gives
+    // the same population when it is built again with the same number of threads
+    if (benchmarkInit) {
+        const int populationSize = 1000;
+        uint64_t benchmarkSeed = seed == RANDOM_SEED ? 42 : seed;
+        unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << std::endl;
+        for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Individual> population = initializePopulation(problemInstance, populationSize, strategy, nullptr, threads, benchmarkSeed, repair, maxSplitsPerStop);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::vector<Individual> again = initializePopulation(problemInstance, populationSize, strategy, nullptr, threads, benchmarkSeed, repair, maxSplitsPerStop);
+            bool reproducible = true;
+            for (int i = 0; i < populationSize; ++i) {
+                reproducible = reproducible && population[i].fitness == again[i].fitness;
+            }
+            std::cout << "Initialization of " << populationSize << " individuals with " << threads << " threads: " << seconds << " s"
+                      << (reproducible ? " (reproducible)" : " (NOT reproducible)") << std::endl;
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    // Quality and time of the initial population built by each construction and repair strategy
+    if (compareConstruction) {
+        const int populationSize = 100;
+        std::cout << std::endl;
+        for (auto [constructionName, constructionStrategy] : { std::make_pair("random buses and nodes", ConstructionStrategy::RandomBusesAndNodes),
+                                                               std::make_pair("savings", ConstructionStrategy::Savings),
+                                                               std::make_pair("sweep", ConstructionStrategy::Sweep) })
+        for (auto [repairName, repairStrategy] : { std::make_pair("probability", RepairStrategy::Probability),
+                                                   std::make_pair("cheapest insertion", RepairStrategy::Cheapest),
+                                                   std::make_pair("regret insertion", RepairStrategy::Regret) }) {
+            std::string name = std::string(constructionName) + " + " + repairName;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Individual> population = initializePopulation(problemInstance, populationSize, constructionStrategy, nullptr, numThreads, seed, repairStrategy, maxSplitsPerStop);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double best = std::numeric_limits<double>::max();
+            double total = 0.0;
+            for (const Individual& individual : population) {
+                best = std::min(best, individual.fitness);
+                total += individual.fitness;
+            }
+            std::cout << "Construction " << name << ": best fitness " << best << ", mean fitness " << total / population.size()
+                      << " (" << populationSize << " individuals in " << seconds << " s)" << std::endl;
+        }
+        return 0;
+    }
+
+    // Initialization of a population with and without the cache of the route orderings
+    if (routeCacheReport) {
+        const int populationSize = 200;
+        auto start = std::chrono::steady_clock::now();
+        initializePopulation(problemInstance, populationSize, strategy, nullptr, numThreads, seed, repair, maxSplitsPerStop);
+        double uncachedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        RouteCostCache routeCache(problemInstance.getDistancesMatrix().size());
+        start = std::chrono::steady_clock::now();
+        initializePopulation(problemInstance, populationSize, strategy, &routeCache, numThreads, seed, repair, maxSplitsPerStop);
+        double cachedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "\nInitialization of " << populationSize << " individuals: " << uncachedSeconds << " s without the route cache, "
+                  << cachedSeconds << " s with it" << std::endl;
+        routeCache.printStatistics();
+        return 0;
+    }
+
+    // Time-aware evaluation: the objective of a population with the time constraints (the times are loaded here).
+    // With --repair=cheapest or --repair=regret the stops are inserted where they keep the constraints
+    if (timeAware) {
+        std::vector<Individual> population = initializePopulation(problemInstance, 20, strategy, nullptr, numThreads, seed, repair, maxSplitsPerStop,
+                                                                  &timeConstraints);
+        std::cout << "\nTime-aware evaluation (alpha " << timeConstraints.alpha << ", max ride time " << timeConstraints.maxRideTime
+                  << " s, school deadline " << timeConstraints.schoolDeadline << " s)" << std::endl;
+        for (size_t i = 0; i < population.size(); ++i) {
+            double objective = calculateRoutesFitness(population[i].routes, problemInstance, timeConstraints);
+            double rideTime = 0.0;
+            double violation = 0.0;
+            for (const Route& route : population[i].routes) {
+                rideTime += route.times.weightedRideTime;
+                violation += route.times.violation;
+            }
+            std::cout << "Individual " << i + 1 << ": distance " << population[i].fitness << ", weighted ride time " << rideTime
+                      << ", violation " << violation << ", objective " << objective << std::endl;
+        }
+        return 0;
+    }
 
     //// Initialize the population
     //std::cout << "\nInitializing the population...\n";
@@ -1389,11 +3188,16 @@ int main() {
    // Test bind nnn
     std::vector<int> clusterNodes = {16,17};
 
-    Route route(1);
+    Route route(1, problemInstance.getNumberOfSchools());
     route.visitedNodes = {0, 1,2,3,4,5,6,7,8,9, 16,17 };
-    Individual individual({route}, 0.0);
+    refreshRouteCache(route, problemInstance.getDistancesMatrix());
+    Individual individual({route}, route.cost);
 
     bind_nnn(individual, clusterNodes, problemInstance.getDistancesMatrix());
+
+    // Test move partial load (on an individual of the initial population, whose routes have their pickups)
+    std::vector<Individual> splitPopulation = initializePopulation(problemInstance, 1, strategy, nullptr, 1, seed, repair, maxSplitsPerStop);
+    move_partial_load(splitPopulation[0], problemInstance, problemInstance.getBusesCapacity(), maxSplitsPerStop);
     
 
 